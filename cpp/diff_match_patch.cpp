@@ -19,9 +19,29 @@
 #include <algorithm>
 #include <limits>
 // Code known to compile and run with Qt 4.3 through Qt 4.7.
+// The shared core requires a C++17 compiler (see diff_match_patch.pro).
 #include <QtCore>
 #include <time.h>
 #include "diff_match_patch.h"
+#include "../cpp17/diff_match_patch_core.h"
+
+namespace
+{
+    // The shared character-type-agnostic core.  QString stores UTF-16, so
+    // the char16_t instantiation runs directly on QString's buffer: the
+    // views below are zero-copy reinterpretations, no transcoding happens.
+    using TCore = NDiffMatchPatch::basic_diff_match_patch< char16_t >;
+
+    std::u16string_view toView( const QString &text )
+    {
+        return std::u16string_view( reinterpret_cast< const char16_t * >( text.unicode() ), static_cast< std::size_t >( text.length() ) );
+    }
+
+    QString toQString( std::u16string_view view )
+    {
+        return QString( reinterpret_cast< const QChar * >( view.data() ), static_cast< int >( view.length() ) );
+    }
+}
 
 //////////////////////////
 //
@@ -394,139 +414,22 @@ QList< Diff > diff_match_patch::diff_lineMode( QString text1, QString text2, clo
 
 QList< Diff > diff_match_patch::diff_bisect( const QString &text1, const QString &text2, clock_t deadline )
 {
-    // Cache the text lengths to prevent multiple calls.
-    const int text1_length = text1.length();
-    const int text2_length = text2.length();
-    const int max_d = ( text1_length + text2_length + 1 ) / 2;
-    const int v_offset = max_d;
-    const int v_length = 2 * max_d;
-    int *v1 = new int[ v_length ];
-    int *v2 = new int[ v_length ];
-    for ( int x = 0; x < v_length; x++ )
-    {
-        v1[ x ] = -1;
-        v2[ x ] = -1;
-    }
-    v1[ v_offset + 1 ] = 0;
-    v2[ v_offset + 1 ] = 0;
-    const int delta = text1_length - text2_length;
-    // If the total number of characters is odd, then the front path will
-    // collide with the reverse path.
-    const bool front = ( delta % 2 != 0 );
-    // Offsets for start and end of k loop.
-    // Prevents mapping of space beyond the grid.
-    int k1start = 0;
-    int k1end = 0;
-    int k2start = 0;
-    int k2end = 0;
-    for ( int d = 0; d < max_d; d++ )
-    {
-        // Bail out if deadline is reached.
-        if ( clock() > deadline )
-        {
-            break;
-        }
-
-        // Walk the front path one step.
-        for ( int k1 = -d + k1start; k1 <= d - k1end; k1 += 2 )
-        {
-            const int k1_offset = v_offset + k1;
-            int x1;
-            if ( k1 == -d || ( k1 != d && v1[ k1_offset - 1 ] < v1[ k1_offset + 1 ] ) )
-            {
-                x1 = v1[ k1_offset + 1 ];
-            }
-            else
-            {
-                x1 = v1[ k1_offset - 1 ] + 1;
-            }
-            int y1 = x1 - k1;
-            while ( x1 < text1_length && y1 < text2_length && text1[ x1 ] == text2[ y1 ] )
-            {
-                x1++;
-                y1++;
-            }
-            v1[ k1_offset ] = x1;
-            if ( x1 > text1_length )
-            {
-                // Ran off the right of the graph.
-                k1end += 2;
-            }
-            else if ( y1 > text2_length )
-            {
-                // Ran off the bottom of the graph.
-                k1start += 2;
-            }
-            else if ( front )
-            {
-                int k2_offset = v_offset + delta - k1;
-                if ( k2_offset >= 0 && k2_offset < v_length && v2[ k2_offset ] != -1 )
-                {
-                    // Mirror x2 onto top-left coordinate system.
-                    int x2 = text1_length - v2[ k2_offset ];
-                    if ( x1 >= x2 )
-                    {
-                        // Overlap detected.
-                        delete[] v1;
-                        delete[] v2;
-                        return diff_bisectSplit( text1, text2, x1, y1, deadline );
-                    }
-                }
-            }
-        }
+    // The Myers walk lives in the shared core; convert the legacy
+    // clock()-based deadline into the core's steady-clock one.
+    NDiffMatchPatch::SDeadline coreDeadline;
+    if ( deadline != std::numeric_limits< clock_t >::max() )
+    {
+        const float remaining = float( deadline - clock() ) / CLOCKS_PER_SEC;
+        coreDeadline = ( remaining > 0 ) ? NDiffMatchPatch::SDeadline( remaining ) : NDiffMatchPatch::SDeadline::expired();
+    }
 
-        // Walk the reverse path one step.
-        for ( int k2 = -d + k2start; k2 <= d - k2end; k2 += 2 )
-        {
-            const int k2_offset = v_offset + k2;
-            int x2;
-            if ( k2 == -d || ( k2 != d && v2[ k2_offset - 1 ] < v2[ k2_offset + 1 ] ) )
-            {
-                x2 = v2[ k2_offset + 1 ];
-            }
-            else
-            {
-                x2 = v2[ k2_offset - 1 ] + 1;
-            }
-            int y2 = x2 - k2;
-            while ( x2 < text1_length && y2 < text2_length && text1[ text1_length - x2 - 1 ] == text2[ text2_length - y2 - 1 ] )
-            {
-                x2++;
-                y2++;
-            }
-            v2[ k2_offset ] = x2;
-            if ( x2 > text1_length )
-            {
-                // Ran off the left of the graph.
-                k2end += 2;
-            }
-            else if ( y2 > text2_length )
-            {
-                // Ran off the top of the graph.
-                k2start += 2;
-            }
-            else if ( !front )
-            {
-                int k1_offset = v_offset + delta - k2;
-                if ( k1_offset >= 0 && k1_offset < v_length && v1[ k1_offset ] != -1 )
-                {
-                    int x1 = v1[ k1_offset ];
-                    int y1 = v_offset + x1 - k1_offset;
-                    // Mirror x2 onto top-left coordinate system.
-                    x2 = text1_length - x2;
-                    if ( x1 >= x2 )
-                    {
-                        // Overlap detected.
-                        delete[] v1;
-                        delete[] v2;
-                        return diff_bisectSplit( text1, text2, x1, y1, deadline );
-                    }
-                }
-            }
-        }
+    std::size_t x = 0;
+    std::size_t y = 0;
+    if ( TCore::diff_bisect( toView( text1 ), toView( text2 ), coreDeadline, x, y ) )
+    {
+        // Found a middle snake, split the problem in two and recurse.
+        return diff_bisectSplit( text1, text2, static_cast< int >( x ), static_cast< int >( y ), deadline );
     }
-    delete[] v1;
-    delete[] v2;
     // Diff took too long and hit the deadline or
     // number of diffs equals number of characters, no commonality at all.
     QList< Diff > diffs;
@@ -621,82 +524,17 @@ void diff_match_patch::diff_charsToLines( QList< Diff > &diffs, const QStringLis
 
 int diff_match_patch::diff_commonPrefix( const QString &text1, const QString &text2 )
 {
-    // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-    const int n = std::min( text1.length(), text2.length() );
-    for ( int i = 0; i < n; i++ )
-    {
-        if ( text1[ i ] != text2[ i ] )
-        {
-            return i;
-        }
-    }
-    return n;
+    return static_cast< int >( TCore::diff_commonPrefix( toView( text1 ), toView( text2 ) ) );
 }
 
 int diff_match_patch::diff_commonSuffix( const QString &text1, const QString &text2 )
 {
-    // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-    const int text1_length = text1.length();
-    const int text2_length = text2.length();
-    const int n = std::min( text1_length, text2_length );
-    for ( int i = 1; i <= n; i++ )
-    {
-        if ( text1[ text1_length - i ] != text2[ text2_length - i ] )
-        {
-            return i - 1;
-        }
-    }
-    return n;
+    return static_cast< int >( TCore::diff_commonSuffix( toView( text1 ), toView( text2 ) ) );
 }
 
 int diff_match_patch::diff_commonOverlap( const QString &text1, const QString &text2 )
 {
-    // Cache the text lengths to prevent multiple calls.
-    const int text1_length = text1.length();
-    const int text2_length = text2.length();
-    // Eliminate the null case.
-    if ( text1_length == 0 || text2_length == 0 )
-    {
-        return 0;
-    }
-    // Truncate the longer string.
-    QString text1_trunc = text1;
-    QString text2_trunc = text2;
-    if ( text1_length > text2_length )
-    {
-        text1_trunc = text1.right( text2_length );
-    }
-    else if ( text1_length < text2_length )
-    {
-        text2_trunc = text2.left( text1_length );
-    }
-    const int text_length = std::min( text1_length, text2_length );
-    // Quick check for the worst case.
-    if ( text1_trunc == text2_trunc )
-    {
-        return text_length;
-    }
-
-    // Start by looking for a single character match
-    // and increase length until no match is found.
-    // Performance analysis: http://neil.fraser.name/news/2010/11/04/
-    int best = 0;
-    int length = 1;
-    while ( true )
-    {
-        QString pattern = text1_trunc.right( length );
-        int found = text2_trunc.indexOf( pattern );
-        if ( found == -1 )
-        {
-            return best;
-        }
-        length += found;
-        if ( found == 0 || text1_trunc.right( length ) == text2_trunc.left( length ) )
-        {
-            best = length;
-            length++;
-        }
-    }
+    return static_cast< int >( TCore::diff_commonOverlap( toView( text1 ), toView( text2 ) ) );
 }
 
 QStringList diff_match_patch::diff_halfMatch( const QString &text1, const QString &text2 )
@@ -706,80 +544,13 @@ QStringList diff_match_patch::diff_halfMatch( const QString &text1, const QStrin
         // Don't risk returning a non-optimal diff if we have unlimited time.
         return QStringList();
     }
-    const QString longtext = text1.length() > text2.length() ? text1 : text2;
-    const QString shorttext = text1.length() > text2.length() ? text2 : text1;
-    if ( longtext.length() < 4 || shorttext.length() * 2 < longtext.length() )
-    {
-        return QStringList();   // Pointless.
-    }
-
-    // First check if the second quarter is the seed for a half-match.
-    const QStringList hm1 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 3 ) / 4 );
-    // Check again based on the third quarter.
-    const QStringList hm2 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 1 ) / 2 );
-    QStringList hm;
-    if ( hm1.isEmpty() && hm2.isEmpty() )
-    {
-        return QStringList();
-    }
-    else if ( hm2.isEmpty() )
-    {
-        hm = hm1;
-    }
-    else if ( hm1.isEmpty() )
-    {
-        hm = hm2;
-    }
-    else
-    {
-        // Both matched.  Select the longest.
-        hm = hm1[ 4 ].length() > hm2[ 4 ].length() ? hm1 : hm2;
-    }
-
-    // A half-match was found, sort out the return data.
-    if ( text1.length() > text2.length() )
-    {
-        return hm;
-    }
-    else
+    const auto hm = TCore::diff_halfMatch( toView( text1 ), toView( text2 ) );
+    QStringList listRet;
+    for ( auto &&piece : hm )
     {
-        QStringList listRet;
-        listRet << hm[ 2 ] << hm[ 3 ] << hm[ 0 ] << hm[ 1 ] << hm[ 4 ];
-        return listRet;
-    }
-}
-
-QStringList diff_match_patch::diff_halfMatchI( const QString &longtext, const QString &shorttext, int i )
-{
-    // Start with a 1/4 length substring at position i as a seed.
-    const QString seed = safeMid( longtext, i, longtext.length() / 4 );
-    int j = -1;
-    QString best_common;
-    QString best_longtext_a, best_longtext_b;
-    QString best_shorttext_a, best_shorttext_b;
-    while ( ( j = shorttext.indexOf( seed, j + 1 ) ) != -1 )
-    {
-        const int prefixLength = diff_commonPrefix( safeMid( longtext, i ), safeMid( shorttext, j ) );
-        const int suffixLength = diff_commonSuffix( longtext.left( i ), shorttext.left( j ) );
-        if ( best_common.length() < suffixLength + prefixLength )
-        {
-            best_common = safeMid( shorttext, j - suffixLength, suffixLength ) + safeMid( shorttext, j, prefixLength );
-            best_longtext_a = longtext.left( i - suffixLength );
-            best_longtext_b = safeMid( longtext, i + prefixLength );
-            best_shorttext_a = shorttext.left( j - suffixLength );
-            best_shorttext_b = safeMid( shorttext, j + prefixLength );
-        }
-    }
-    if ( best_common.length() * 2 >= longtext.length() )
-    {
-        QStringList listRet;
-        listRet << best_longtext_a << best_longtext_b << best_shorttext_a << best_shorttext_b << best_common;
-        return listRet;
-    }
-    else
-    {
-        return QStringList();
+        listRet << toQString( piece );
     }
+    return listRet;
 }
 
 void diff_match_patch::diff_cleanupSemantic( QList< Diff > &diffs )
@@ -318,19 +318,6 @@ protected:
 protected:
     QStringList diff_halfMatch( const QString &text1, const QString &text2 );
 
-    /**
-   * Does a substring of shorttext exist within longtext such that the
-   * substring is at least half the length of longtext?
-   * @param longtext Longer string.
-   * @param shorttext Shorter string.
-   * @param i Start index of quarter length substring within longtext.
-   * @return Five element String array, containing the prefix of longtext, the
-   *     suffix of longtext, the prefix of shorttext, the suffix of shorttext
-   *     and the common middle.  Or null if there was no match.
-   */
-private:
-    QStringList diff_halfMatchI( const QString &longtext, const QString &shorttext, int i );
-
     /**
    * Reduce the number of edits by eliminating semantically trivial equalities.
    * @param diffs LinkedList of Diff objects.
@@ -11,9 +11,13 @@ mac {
 
 FORMS =
 
-HEADERS = diff_match_patch.h diff_match_patch_test.h
+# The hot diff kernels are shared with the cpp17 port.
+CONFIG += c++17
+INCLUDEPATH += ../cpp17
 
-SOURCES = diff_match_patch.cpp diff_match_patch_test.cpp
+HEADERS = diff_match_patch.h diff_match_patch_test.h ../cpp17/diff_match_patch_core.h
+
+SOURCES = diff_match_patch.cpp diff_match_patch_test.cpp ../cpp17/diff_match_patch_core.cpp
 
 RESOURCES = 
 
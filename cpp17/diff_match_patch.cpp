@@ -18,12 +18,15 @@
 
 #include "diff_match_patch.h"
 
+#include "diff_match_patch_core.h"
+
 #include <algorithm>
 #include <codecvt>
-#include <ctime>
 #include <cwctype>
+#include <future>
 #include <limits>
 #include <list>
+#include <ostream>
 #include <stack>
 #include <unordered_map>
 
@@ -39,6 +42,10 @@ namespace NDiffMatchPatch
     static unsigned long kONE{ 1UL };
 #endif
 
+    // Below this text length patch_addContext keeps probing with direct
+    // scans; building a q-gram index would cost more than the scans save.
+    static constexpr std::size_t kContextIndexThreshold{ 1024 };
+
     std::wstring toString( EOperation op )
     {
         switch ( op )
@@ -102,39 +109,200 @@ namespace NDiffMatchPatch
         return retVal;
     }
 
+    namespace
+    {
+        // Shared by the string and stream renderers: one pass over the text,
+        // appending the unescaped runs in bulk instead of a replace() rescan
+        // (and reallocation) per escapable character.
+        constexpr const wchar_t *htmlEscape( wchar_t ch )
+        {
+            switch ( ch )
+            {
+                case L'&':
+                    return L"&amp;";
+                case L'<':
+                    return L"&lt;";
+                case L'>':
+                    return L"&gt;";
+                default:
+                    return L"&para;<br>";
+            }
+        }
+
+        void appendHtmlEscaped( std::wstring &out, const std::wstring &text )
+        {
+            std::size_t pos = 0;
+            while ( pos < text.length() )
+            {
+                auto stop = text.find_first_of( L"&<>\n", pos );
+                if ( stop == std::wstring::npos )
+                {
+                    out.append( text, pos, std::wstring::npos );
+                    return;
+                }
+                out.append( text, pos, stop - pos );
+                out += htmlEscape( text[ stop ] );
+                pos = stop + 1;
+            }
+        }
+
+        void writeHtmlEscaped( std::wostream &out, const std::wstring &text )
+        {
+            std::size_t pos = 0;
+            while ( pos < text.length() )
+            {
+                auto stop = text.find_first_of( L"&<>\n", pos );
+                if ( stop == std::wstring::npos )
+                {
+                    out.write( text.data() + pos, text.length() - pos );
+                    return;
+                }
+                out.write( text.data() + pos, stop - pos );
+                out << htmlEscape( text[ stop ] );
+                pos = stop + 1;
+            }
+        }
+
+        // Console colour codes and the pilcrow line-break marker.
+        const std::wstring kRed{ L"\033[0;31m" };
+        const std::wstring kGreen{ L"\033[0;32m" };
+        const std::wstring kReset{ L"\033[m" };
+        const std::wstring kEOL{ L'\u00b6', L'\n' };
+
+        void appendConsoleEscaped( std::wstring &out, const std::wstring &text )
+        {
+            std::size_t pos = 0;
+            while ( pos < text.length() )
+            {
+                auto stop = text.find( L'\n', pos );
+                if ( stop == std::wstring::npos )
+                {
+                    out.append( text, pos, std::wstring::npos );
+                    return;
+                }
+                out.append( text, pos, stop - pos );
+                out += kEOL;
+                pos = stop + 1;
+            }
+        }
+
+        void writeConsoleEscaped( std::wostream &out, const std::wstring &text )
+        {
+            std::size_t pos = 0;
+            while ( pos < text.length() )
+            {
+                auto stop = text.find( L'\n', pos );
+                if ( stop == std::wstring::npos )
+                {
+                    out.write( text.data() + pos, text.length() - pos );
+                    return;
+                }
+                out.write( text.data() + pos, stop - pos );
+                out << kEOL;
+                pos = stop + 1;
+            }
+        }
+    }
+
     std::wstring Diff::toHtml() const
     {
-        auto text = this->text();
-        NUtils::replace( text, L"&", L"&amp;" );
-        NUtils::replace( text, L"<", L"&lt;" );
-        NUtils::replace( text, L">", L"&gt;" );
-        NUtils::replace( text, L"\n", L"&para;<br>" );
+        std::wstring retVal;
+        toHtml( retVal );
+        return retVal;
+    }
+
+    void Diff::toHtml( std::wstring &out ) const
+    {
+        // Tags plus a little slack for escapes.
+        out.reserve( out.length() + text().length() + 64 );
         if ( isInsert() )
-            return std::wstring( L"<ins style=\"background:#e6ffe6;\">" ) + text + std::wstring( L"</ins>" );
+        {
+            out += L"<ins style=\"background:#e6ffe6;\">";
+            appendHtmlEscaped( out, text() );
+            out += L"</ins>";
+        }
         else if ( isDelete() )
-            return std::wstring( L"<del style=\"background:#ffe6e6;\">" ) + text + std::wstring( L"</del>" );
+        {
+            out += L"<del style=\"background:#ffe6e6;\">";
+            appendHtmlEscaped( out, text() );
+            out += L"</del>";
+        }
         else if ( isEqual() )
-            return std::wstring( L"<span>" ) + text + std::wstring( L"</span>" );
-        return {};
+        {
+            out += L"<span>";
+            appendHtmlEscaped( out, text() );
+            out += L"</span>";
+        }
+    }
+
+    void Diff::toHtml( std::wostream &out ) const
+    {
+        if ( isInsert() )
+        {
+            out << L"<ins style=\"background:#e6ffe6;\">";
+            writeHtmlEscaped( out, text() );
+            out << L"</ins>";
+        }
+        else if ( isDelete() )
+        {
+            out << L"<del style=\"background:#ffe6e6;\">";
+            writeHtmlEscaped( out, text() );
+            out << L"</del>";
+        }
+        else if ( isEqual() )
+        {
+            out << L"<span>";
+            writeHtmlEscaped( out, text() );
+            out << L"</span>";
+        }
     }
 
     std::wstring Diff::toConsole() const
     {
-        static std::wstring kRed{ L"\033[0;31m" };
-        static std::wstring kGreen{ L"\033[0;32m" };
-        static std::wstring kYellow{ L"\033[0;33m" };
-        static std::wstring kReset{ L"\033[m" };
-        static std::wstring kEOL{ NUtils::fromPercentEncoding( L"%C2%B6" ) + L"\n" };
+        std::wstring retVal;
+        toConsole( retVal );
+        return retVal;
+    }
 
-        auto retVal = text();
-        NUtils::replace( retVal, L"\n", kEOL );
+    void Diff::toConsole( std::wstring &out ) const
+    {
+        out.reserve( out.length() + text().length() + 16 );
         if ( isInsert() )
-            return kGreen + retVal + kReset;
+        {
+            out += kGreen;
+            appendConsoleEscaped( out, text() );
+            out += kReset;
+        }
         else if ( isDelete() )
-            return kRed + retVal + kReset;
+        {
+            out += kRed;
+            appendConsoleEscaped( out, text() );
+            out += kReset;
+        }
         else if ( isEqual() )
-            return retVal;
-        return {};
+        {
+            appendConsoleEscaped( out, text() );
+        }
+    }
+
+    void Diff::toConsole( std::wostream &out ) const
+    {
+        if ( isInsert() )
+        {
+            out << kGreen;
+            writeConsoleEscaped( out, text() );
+            out << kReset;
+        }
+        else if ( isDelete() )
+        {
+            out << kRed;
+            writeConsoleEscaped( out, text() );
+            out << kReset;
+        }
+        else if ( isEqual() )
+        {
+            writeConsoleEscaped( out, text() );
+        }
     }
 
     std::wstring Diff::toDelta() const
@@ -245,6 +413,15 @@ namespace NDiffMatchPatch
         return text;
     }
 
+    void Patch::toString( std::wostream &out ) const
+    {
+        out << getPatchHeader();
+        for ( auto &&aDiff : diffs )
+        {
+            out << aDiff.toString( EStringType::ePatch );
+        }
+    }
+
     std::wstring Patch::getPatchHeader() const
     {
         auto coords1 = getCoordinateString( start1, length1 );
@@ -282,6 +459,56 @@ namespace NDiffMatchPatch
     {
     }
 
+    diff_match_patch::diff_match_patch( const SOptions &options )
+    {
+        setOptions( options );
+    }
+
+    diff_match_patch::SOptions diff_match_patch::options() const
+    {
+        SOptions options;
+        options.fDiffTimeout = Diff_Timeout;
+        options.fDiffCancel = Diff_Cancel;
+        options.fDiffEditCost = Diff_EditCost;
+        options.fMatchThreshold = Match_Threshold;
+        options.fMatchDistance = Match_Distance;
+        options.fPatchDeleteThreshold = Patch_DeleteThreshold;
+        options.fPatchMargin = Patch_Margin;
+        options.fMatchMaxBits = Match_MaxBits;
+        options.fDiffThreads = Diff_Threads;
+        return options;
+    }
+
+    void diff_match_patch::setOptions( const SOptions &options )
+    {
+        Diff_Timeout = options.fDiffTimeout;
+        Diff_Cancel = options.fDiffCancel;
+        Diff_EditCost = options.fDiffEditCost;
+        Match_Threshold = options.fMatchThreshold;
+        Match_Distance = options.fMatchDistance;
+        Patch_DeleteThreshold = options.fPatchDeleteThreshold;
+        Patch_Margin = options.fPatchMargin;
+        Match_MaxBits = options.fMatchMaxBits;
+        Diff_Threads = options.fDiffThreads;
+        Diff_CollectStats = ( options.fStats != nullptr );
+    }
+
+    TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2, const SOptions &options ) const
+    {
+        return diff_main( text1, text2, true, options );
+    }
+
+    TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines, const SOptions &options ) const
+    {
+        // The shared instance stays untouched: all state for this call
+        // lives in a private engine built from the options.
+        diff_match_patch engine( options );
+        auto diffs = engine.diff_main( text1, text2, checklines );
+        if ( options.fStats )
+            *options.fStats = engine.diff_lastStats();
+        return diffs;
+    }
+
     TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2 )
     {
         return diff_main( text1, text2, true );
@@ -290,19 +517,26 @@ namespace NDiffMatchPatch
     TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines )
     {
         // Set a deadline by which time the diff must be complete.
-        clock_t deadline;
-        if ( Diff_Timeout <= 0 )
-        {
-            deadline = std::numeric_limits< clock_t >::max();
-        }
-        else
-        {
-            deadline = clock() + (clock_t)( Diff_Timeout * CLOCKS_PER_SEC );
-        }
-        return diff_main( text1, text2, checklines, deadline );
+        SDeadline deadline( Diff_Timeout, Diff_Cancel );
+        // One bisect workspace is shared by the whole recursion; the thread
+        // budget is shared by any workers the recursion fans out to.
+        std::atomic< int > threadBudget{ Diff_Threads };
+        SDiffContext context( &threadBudget );
+        if ( !Diff_CollectStats )
+        {
+            return diff_main( text1, text2, checklines, deadline, context );
+        }
+
+        fLastStats = SDiffStats();
+        context.fStats = &fLastStats;
+        auto start = std::chrono::steady_clock::now();
+        auto diffs = diff_main( text1, text2, checklines, deadline, context );
+        fLastStats.fTotalSeconds = std::chrono::duration< float >( std::chrono::steady_clock::now() - start ).count();
+        fLastStats.fBisectIterations = context.fWorkspace.fIterations + context.fTokenWorkspace.fIterations;
+        return diffs;
     }
 
-    TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines, clock_t deadline )
+    TDiffVector diff_match_patch::diff_main( std::wstring_view text1, std::wstring_view text2, bool checklines, const SDeadline &deadline, SDiffContext &context )
     {
         // Check for equality (speedup).
         TDiffVector diffs;
@@ -312,35 +546,47 @@ namespace NDiffMatchPatch
             {
                 diffs.emplace_back( EOperation::eEQUAL, text1 );
             }
+            if ( context.fProgress )
+                context.fProgress->settle( text1.length() + text2.length() );
             return diffs;
         }
 
         if ( !text1.empty() && text2.empty() )
         {
             diffs.emplace_back( EOperation::eDELETE, text1 );
+            if ( context.fProgress )
+                context.fProgress->settle( text1.length() );
             return diffs;
         }
 
         if ( text1.empty() && !text2.empty() )
         {
             diffs.emplace_back( EOperation::eINSERT, text2 );
+            if ( context.fProgress )
+                context.fProgress->settle( text2.length() );
             return diffs;
         }
 
-        // Trim off common prefix (speedup).
-        auto commonlength = diff_commonPrefix( text1, text2 );
+        // Trim off common prefix (speedup).  The trimmed pieces stay views
+        // into the caller's buffers; nothing is copied until hunks are
+        // materialized.
+        auto commonlength = basic_diff_match_patch< wchar_t >::diff_commonPrefix( text1, text2 );
         auto commonprefix = text1.substr( 0, commonlength );
         auto textChopped1 = text1.substr( commonlength );
         auto textChopped2 = text2.substr( commonlength );
 
         // Trim off common suffix (speedup).
-        commonlength = diff_commonSuffix( textChopped1, textChopped2 );
+        commonlength = basic_diff_match_patch< wchar_t >::diff_commonSuffix( textChopped1, textChopped2 );
         auto commonsuffix = textChopped1.substr( textChopped1.length() - commonlength );
         textChopped1 = textChopped1.substr( 0, textChopped1.length() - commonlength );
         textChopped2 = textChopped2.substr( 0, textChopped2.length() - commonlength );
 
+        // Trimmed affixes appear in both texts, so they settle twice over.
+        if ( context.fProgress )
+            context.fProgress->settle( 2 * ( commonprefix.length() + commonsuffix.length() ) );
+
         // Compute the diff on the middle block.
-        diffs = diff_compute( textChopped1, textChopped2, checklines, deadline );
+        diffs = diff_compute( textChopped1, textChopped2, checklines, deadline, context );
 
         // Restore the prefix and suffix.
         if ( !commonprefix.empty() )
@@ -352,7 +598,22 @@ namespace NDiffMatchPatch
             diffs.emplace_back( EOperation::eEQUAL, commonsuffix );
         }
 
-        diff_cleanupMerge( diffs );
+        if ( context.fStats && ( context.fDepth == 0 ) )
+        {
+            // Only the outermost cleanup is the "final" one worth timing.
+            auto sizeBefore = diffs.size();
+            auto start = std::chrono::steady_clock::now();
+            diff_cleanupMerge( diffs );
+            context.fStats->fCleanupSeconds += std::chrono::duration< float >( std::chrono::steady_clock::now() - start ).count();
+            if ( diffs.size() < sizeBefore )
+            {
+                context.fStats->fCleanupRemoved += sizeBefore - diffs.size();
+            }
+        }
+        else
+        {
+            diff_cleanupMerge( diffs );
+        }
 
         return diffs;
     }
@@ -362,24 +623,236 @@ namespace NDiffMatchPatch
         return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
     }
 
+    TDiffVector diff_match_patch::diff_main( const std::wstring &text1, const std::wstring &text2, EDiffGranularity granularity )
+    {
+        // Character and line granularity map straight onto the checklines flag.
+        if ( granularity == EDiffGranularity::eCHARACTER )
+        {
+            return diff_main( text1, text2, false );
+        }
+        if ( granularity == EDiffGranularity::eLINE )
+        {
+            return diff_main( text1, text2, true );
+        }
+
+        // Set a deadline by which time the diff must be complete.
+        SDeadline deadline( Diff_Timeout, Diff_Cancel );
+        std::atomic< int > threadBudget{ Diff_Threads };
+        SDiffContext context( &threadBudget );
+        return diff_tokenMode( text1, text2, granularity, deadline, context );
+    }
+
+    TDiffVector diff_match_patch::diff_main( const std::string &text1, const std::string &text2, EDiffGranularity granularity )
+    {
+        return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), granularity );
+    }
+
+    TDiffVector diff_match_patch::diff_wordMode( const std::wstring &text1, const std::wstring &text2 )
+    {
+        return diff_main( text1, text2, EDiffGranularity::eWORD );
+    }
+
+    TDiffVector diff_match_patch::diff_wordMode( const std::string &text1, const std::string &text2 )
+    {
+        return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), EDiffGranularity::eWORD );
+    }
+
+    TDiffVector diff_match_patch::diff_sentenceMode( const std::wstring &text1, const std::wstring &text2 )
+    {
+        return diff_main( text1, text2, EDiffGranularity::eSENTENCE );
+    }
+
+    TDiffVector diff_match_patch::diff_sentenceMode( const std::string &text1, const std::string &text2 )
+    {
+        return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), EDiffGranularity::eSENTENCE );
+    }
+
+    TDiffSpanVector diff_match_patch::diff_main_spans( const std::wstring &text1, const std::wstring &text2 )
+    {
+        return diff_main_spans( text1, text2, true );
+    }
+
+    TDiffSpanVector diff_match_patch::diff_main_spans( const std::wstring &text1, const std::wstring &text2, bool checklines )
+    {
+        auto diffs = diff_main( text1, text2, checklines );
+
+        // A valid diff reconstructs text1 from its equalities and deletions and
+        // text2 from its equalities and insertions, so each hunk can be located
+        // in the inputs purely by cumulative offset.  Map each hunk back onto
+        // the caller's strings rather than retaining the computed copies.
+        TDiffSpanVector spans;
+        spans.reserve( diffs.size() );
+        std::size_t pos1 = 0;
+        std::size_t pos2 = 0;
+        for ( auto &&aDiff : diffs )
+        {
+            auto len = aDiff.text().length();
+            if ( aDiff.isInsert() )
+            {
+                spans.emplace_back( aDiff.fOperation, std::wstring_view( text2 ).substr( pos2, len ) );
+                pos2 += len;
+            }
+            else if ( aDiff.isDelete() )
+            {
+                spans.emplace_back( aDiff.fOperation, std::wstring_view( text1 ).substr( pos1, len ) );
+                pos1 += len;
+            }
+            else
+            {
+                spans.emplace_back( aDiff.fOperation, std::wstring_view( text1 ).substr( pos1, len ) );
+                pos1 += len;
+                pos2 += len;
+            }
+        }
+        return spans;
+    }
+
+    std::vector< TDiffVector > diff_match_patch::diff_batch( const TTextPairVector &pairs, int numThreads )
+    {
+        return diff_batch( pairs, true, numThreads );
+    }
+
+    std::vector< TDiffVector > diff_match_patch::diff_batch( const TTextPairVector &pairs, bool checklines, int numThreads )
+    {
+        std::vector< TDiffVector > results( pairs.size() );
+        if ( pairs.empty() )
+        {
+            return results;
+        }
+
+        // Workers chase a shared counter, so whichever worker finishes its
+        // pair first claims the next unclaimed one; no pair is ever assigned
+        // to a busy worker.  Each worker holds one context, reusing its
+        // bisect workspace across every pair it runs.
+        std::atomic< std::size_t > nextPair{ 0 };
+        auto worker = [ & ]()
+        {
+            SDiffContext context;
+            for ( auto ii = nextPair.fetch_add( 1 ); ii < pairs.size(); ii = nextPair.fetch_add( 1 ) )
+            {
+                SDeadline deadline( Diff_Timeout, Diff_Cancel );
+                results[ ii ] = diff_main( pairs[ ii ].first, pairs[ ii ].second, checklines, deadline, context );
+            }
+        };
+
+        auto workerCount = std::min( ( numThreads > 1 ) ? static_cast< std::size_t >( numThreads ) : std::size_t( 1 ), pairs.size() );
+        if ( workerCount < 2 )
+        {
+            worker();
+            return results;
+        }
+
+        // This thread is one of the workers; the rest run via async.
+        std::vector< std::future< void > > futures;
+        futures.reserve( workerCount - 1 );
+        for ( std::size_t ii = 1; ii < workerCount; ++ii )
+        {
+            futures.emplace_back( std::async( std::launch::async, worker ) );
+        }
+        worker();
+        for ( auto &&future : futures )
+        {
+            future.get();
+        }
+        return results;
+    }
+
+    void diff_match_patch::SDiffProgress::settle( std::size_t chars )
+    {
+        if ( !fCallback || ( fTotal == 0 ) || ( chars == 0 ) )
+        {
+            return;
+        }
+        auto settled = fSettled.fetch_add( chars ) + chars;
+        auto percent = static_cast< int >( std::min< std::size_t >( 100, ( settled * 100 ) / fTotal ) );
+        // Only the thread that advances the high-water mark reports, so the
+        // callback fires at most once per whole percent.
+        auto last = fLastPercent.load();
+        while ( percent > last )
+        {
+            if ( fLastPercent.compare_exchange_weak( last, percent ) )
+            {
+                fCallback( percent / 100.0f );
+                break;
+            }
+        }
+    }
+
+    std::future< TDiffVector > diff_match_patch::diff_main_async( std::wstring text1, std::wstring text2, TProgressCallback progress ) const
+    {
+        return diff_main_async( std::move( text1 ), std::move( text2 ), options(), std::move( progress ) );
+    }
+
+    std::future< TDiffVector > diff_match_patch::diff_main_async( std::wstring text1, std::wstring text2, const SOptions &options, TProgressCallback progress ) const
+    {
+        // One worker per outstanding call; as with the SOptions overloads,
+        // the shared instance stays untouched, so any number of calls may
+        // be in flight at once and each is cancellable via its options.
+        return std::async( std::launch::async,
+                           [ text1 = std::move( text1 ), text2 = std::move( text2 ), options, progress = std::move( progress ) ]()
+                           {
+                               diff_match_patch engine( options );
+                               SDeadline deadline( engine.Diff_Timeout, engine.Diff_Cancel );
+                               std::atomic< int > threadBudget{ engine.Diff_Threads };
+                               SDiffContext context( &threadBudget );
+                               SDiffProgress progressState;
+                               progressState.fCallback = progress;
+                               progressState.fTotal = text1.length() + text2.length();
+                               context.fProgress = &progressState;
+                               auto diffs = engine.diff_main( text1, text2, true, deadline, context );
+                               if ( progress && ( progressState.fLastPercent.load() < 100 ) )
+                               {
+                                   // The settled estimate undershoots on some
+                                   // paths; completion always reports 1.0.
+                                   progress( 1.0f );
+                               }
+                               return diffs;
+                           } );
+    }
+
     TDiffVector diff_match_patch::diff_main( const std::string &text1, const std::string &text2, bool checklines )
     {
         return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), checklines );
     }
 
-    TDiffVector diff_match_patch::diff_main( const std::string &text1, const std::string &text2, bool checklines, clock_t deadline )
+    TDiffVector diff_match_patch::diff_main( const std::string &text1, const std::string &text2, bool checklines, const SDeadline &deadline, SDiffContext &context )
     {
-        return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), checklines, deadline );
+        return diff_main( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), checklines, deadline, context );
+    }
+
+    namespace
+    {
+        // Tracks diff_compute recursion depth for the stats surface; depth is
+        // maintained even when stats are off so the outermost frame can
+        // always be identified.
+        struct SDepthGuard
+        {
+            explicit SDepthGuard( diff_match_patch::SDiffContext &context ) :
+                fContext( context )
+            {
+                fContext.fDepth++;
+                if ( fContext.fStats && ( fContext.fStats->fMaxDepth < fContext.fDepth ) )
+                {
+                    fContext.fStats->fMaxDepth = fContext.fDepth;
+                }
+            }
+            ~SDepthGuard() { fContext.fDepth--; }
+
+            diff_match_patch::SDiffContext &fContext;
+        };
     }
 
-    TDiffVector diff_match_patch::diff_compute( const std::wstring &text1, const std::wstring &text2, bool checklines, clock_t deadline )
+    TDiffVector diff_match_patch::diff_compute( std::wstring_view text1, std::wstring_view text2, bool checklines, const SDeadline &deadline, SDiffContext &context )
     {
+        SDepthGuard depthGuard( context );
         TDiffVector diffs;
 
         if ( text1.empty() )
         {
             // Just add some text (speedup).
             diffs.emplace_back( EOperation::eINSERT, text2 );
+            if ( context.fProgress )
+                context.fProgress->settle( text2.length() );
             return diffs;
         }
 
@@ -387,6 +860,8 @@ namespace NDiffMatchPatch
         {
             // Just delete some text (speedup).
             diffs.emplace_back( EOperation::eDELETE, text1 );
+            if ( context.fProgress )
+                context.fProgress->settle( text1.length() );
             return diffs;
         }
 
@@ -399,7 +874,9 @@ namespace NDiffMatchPatch
                 const auto op = ( text1.length() > text2.length() ) ? EOperation::eDELETE : EOperation::eINSERT;
                 diffs.emplace_back( op, longtext.substr( 0, i ) );
                 diffs.emplace_back( EOperation::eEQUAL, shorttext );
-                diffs.emplace_back( op, safeMid( longtext, i + shorttext.length() ) );
+                diffs.emplace_back( op, longtext.substr( i + shorttext.length() ) );
+                if ( context.fProgress )
+                    context.fProgress->settle( text1.length() + text2.length() );
                 return diffs;
             }
 
@@ -409,13 +886,25 @@ namespace NDiffMatchPatch
                 // After the previous speedup, the character can't be an equality.
                 diffs.emplace_back( EOperation::eDELETE, text1 );
                 diffs.emplace_back( EOperation::eINSERT, text2 );
+                if ( context.fProgress )
+                    context.fProgress->settle( text1.length() + text2.length() );
                 return diffs;
             }
             // Garbage collect longtext and shorttext by scoping out.
         }
 
-        // Check to see if the problem can be split in two.
-        const TStringVector hm = diff_halfMatch( text1, text2 );
+        // Check to see if the problem can be split in two.  The views point
+        // into text1/text2, which outlive the recursion below.
+        TStringViewVector hm;
+        if ( Diff_Timeout > 0 )
+        {
+            // Don't risk returning a non-optimal diff if we have unlimited time.
+            hm = basic_diff_match_patch< wchar_t >::diff_halfMatch( text1, text2 );
+        }
+        if ( context.fStats )
+        {
+            hm.empty() ? context.fStats->fHalfMatchMisses++ : context.fStats->fHalfMatchHits++;
+        }
         if ( !hm.empty() )
         {
             // A half-match was found, sort out the return data.
@@ -425,40 +914,51 @@ namespace NDiffMatchPatch
             auto &&text2_b = hm[ 3 ];
             auto &&mid_common = hm[ 4 ];
             // Send both pairs off for separate processing.
-            diffs = diff_main( text1_a, text2_a, checklines, deadline );
-            const auto &&diffs_b = diff_main( text1_b, text2_b, checklines, deadline );
+            diffs = diff_main( text1_a, text2_a, checklines, deadline, context );
+            const auto &&diffs_b = diff_main( text1_b, text2_b, checklines, deadline, context );
             // Merge the results.
             diffs.emplace_back( EOperation::eEQUAL, mid_common );
             diffs.insert( diffs.end(), diffs_b.begin(), diffs_b.end() );
+            if ( context.fProgress )
+                context.fProgress->settle( 2 * mid_common.length() );
             return diffs;
         }
 
         // Perform a real diff.
         if ( checklines && ( text1.length() > 100 ) && ( text2.length() > 100 ) )
         {
-            return diff_lineMode( text1, text2, deadline );
+            if ( context.fStats )
+            {
+                context.fStats->fLineModeRuns++;
+            }
+            return diff_lineMode( text1, text2, deadline, context );
         }
 
-        return diff_bisect( text1, text2, deadline );
+        return diff_bisect( text1, text2, deadline, context );
+    }
+
+    TDiffVector diff_match_patch::diff_compute( const std::string &text1, const std::string &text2, bool checklines, const SDeadline &deadline, SDiffContext &context )
+    {
+        return diff_compute( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), checklines, deadline, context );
     }
 
-    TDiffVector diff_match_patch::diff_compute( const std::string &text1, const std::string &text2, bool checklines, clock_t deadline )
+    TDiffVector diff_match_patch::diff_lineMode( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline, SDiffContext &context )
     {
-        return diff_compute( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), checklines, deadline );
+        return diff_tokenMode( text1, text2, EDiffGranularity::eLINE, deadline, context );
     }
 
-    TDiffVector diff_match_patch::diff_lineMode( std::wstring text1, std::wstring text2, clock_t deadline )
+    TDiffVector diff_match_patch::diff_tokenMode( std::wstring_view text1, std::wstring_view text2, EDiffGranularity granularity, const SDeadline &deadline, SDiffContext &context )
     {
-        // Scan the text on a line-by-line basis first.
-        auto a = diff_linesToChars( text1, text2 );
-        text1 = std::get< std::wstring >( a[ 0 ] );
-        text2 = std::get< std::wstring >( a[ 1 ] );
-        auto linearray = std::get< TStringVector >( a[ 2 ] );
+        // Scan the text at the coarse granularity first.  Tokens are interned
+        // as views into text1/text2 (alive for the whole scope) and encoded
+        // as 32-bit ids, so no token is copied during tokenization and the
+        // pre-pass is not capped at 65,535 distinct tokens where wchar_t is
+        // 16 bits wide.
+        auto tokens = diff_textToTokens( text1, text2, granularity );
 
-        auto diffs = diff_main( text1, text2, false, deadline );
+        // The token diff materializes hunks back to line text as it emits them.
+        auto diffs = diff_tokens( tokens.fTokens1, tokens.fTokens2, tokens.fLines, deadline, context );
 
-        // Convert the diff back to original text.
-        diff_charsToLines( diffs, linearray );
         // Eliminate freak matches (e.g. blank lines)
         diff_cleanupSemantic( diffs );
 
@@ -492,10 +992,20 @@ namespace NDiffMatchPatch
                     auto end = start + numElements;
                     diffs.erase( start, end );
                     pointer = pointer - count_delete - count_insert;
-                    auto subDiff = diff_main( text_delete, text_insert, false, deadline );
+                    auto subDiff = diff_main( text_delete, text_insert, false, deadline, context );
                     diffs.insert( diffs.begin() + pointer, subDiff.begin(), subDiff.end() );
                     pointer = pointer + subDiff.size();
                 }
+                else if ( context.fProgress )
+                {
+                    // Unpaired runs keep their coarse hunks; count them now.
+                    context.fProgress->settle( text_delete.length() + text_insert.length() );
+                }
+                if ( context.fProgress )
+                {
+                    // Equalities appear in both texts.
+                    context.fProgress->settle( 2 * diffs[ pointer ].text().length() );
+                }
                 count_insert = 0;
                 count_delete = 0;
                 text_delete.clear();
@@ -508,166 +1018,93 @@ namespace NDiffMatchPatch
         return diffs;
     }
 
-    TDiffVector diff_match_patch::diff_lineMode( std::string text1, std::string text2, clock_t deadline )
-    {
-        return diff_lineMode( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), deadline );
-    }
-
-    // using int64_t rather thant size_t due to the backward walking nature of the
-    // algorithm
-    TDiffVector diff_match_patch::diff_bisect( const std::wstring &text1, const std::wstring &text2, clock_t deadline )
-    {
-        // Cache the text lengths to prevent multiple calls.
-        auto text1_length = static_cast< int64_t >( text1.length() );
-        auto text2_length = static_cast< int64_t >( text2.length() );
-        auto max_d = ( text1_length + text2_length + 1 ) / 2;
-        auto v_offset = max_d;
-        auto v_length = 2 * max_d;
-        auto v1 = std::vector< int64_t >( v_length, -1 );
-        auto v2 = std::vector< int64_t >( v_length, -1 );
-        v1[ v_offset + 1 ] = 0;
-        v2[ v_offset + 1 ] = 0;
-        auto delta = text1_length - text2_length;
-        // If the total number of characters is odd, then the front path will
-        // collide with the reverse path.
-        bool front = ( delta % 2 != 0 );
-        // Offsets for start and end of k loop.
-        // Prevents mapping of space beyond the grid.
-        int64_t k1start = 0;
-        int64_t k1end = 0;
-        int64_t k2start = 0;
-        int64_t k2end = 0;
-        for ( int64_t d = 0; d < max_d; d++ )
-        {
-            // Bail out if deadline is reached.
-            if ( clock() > deadline )
-            {
-                break;
-            }
+    TDiffVector diff_match_patch::diff_lineMode( std::string text1, std::string text2, const SDeadline &deadline, SDiffContext &context )
+    {
+        return diff_lineMode( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), deadline, context );
+    }
 
-            // Walk the front path one step.
-            for ( auto k1 = -d + k1start; k1 <= d - k1end; k1 += 2 )
-            {
-                auto k1_offset = v_offset + k1;
-                int64_t x1;
-                if ( ( k1 == -d ) || ( k1 != d ) && ( v1[ k1_offset - 1 ] < v1[ k1_offset + 1 ] ) )
-                {
-                    x1 = v1[ k1_offset + 1 ];
-                }
-                else
-                {
-                    x1 = v1[ k1_offset - 1 ] + 1;
-                }
-                int64_t y1 = x1 - k1;
-                while ( ( x1 < text1_length ) && ( y1 < text2_length ) && ( text1[ x1 ] == text2[ y1 ] ) )
-                {
-                    x1++;
-                    y1++;
-                }
-                v1[ k1_offset ] = x1;
-                if ( x1 > text1_length )
-                {
-                    // Ran off the right of the graph.
-                    k1end += 2;
-                }
-                else if ( y1 > text2_length )
-                {
-                    // Ran off the bottom of the graph.
-                    k1start += 2;
-                }
-                else if ( front )
-                {
-                    auto k2_offset = v_offset + delta - k1;
-                    if ( ( k2_offset >= 0 ) && ( k2_offset < v_length ) && ( v2[ k2_offset ] != -1 ) )
-                    {
-                        // Mirror x2 onto top-left coordinate system.
-                        auto x2 = text1_length - v2[ k2_offset ];
-                        if ( x1 >= x2 )
-                        {
-                            // Overlap detected.
-                            return diff_bisectSplit( text1, text2, x1, y1, deadline );
-                        }
-                    }
-                }
-            }
+    TDiffVector diff_match_patch::diff_bisect( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline )
+    {
+        SDiffContext context;
+        return diff_bisect( text1, text2, deadline, context );
+    }
 
-            // Walk the reverse path one step.
-            for ( auto k2 = -d + k2start; k2 <= d - k2end; k2 += 2 )
-            {
-                auto k2_offset = v_offset + k2;
-                int64_t x2;
-                if ( ( k2 == -d ) || ( k2 != d ) && ( v2[ k2_offset - 1 ] < v2[ k2_offset + 1 ] ) )
-                {
-                    x2 = v2[ k2_offset + 1 ];
-                }
-                else
-                {
-                    x2 = v2[ k2_offset - 1 ] + 1;
-                }
-                auto y2 = x2 - k2;
-                while ( ( x2 < text1_length ) && ( y2 < text2_length ) && ( text1[ text1_length - x2 - 1 ] == text2[ text2_length - y2 - 1 ] ) )
-                {
-                    x2++;
-                    y2++;
-                }
-                v2[ k2_offset ] = x2;
-                if ( x2 > text1_length )
-                {
-                    // Ran off the left of the graph.
-                    k2end += 2;
-                }
-                else if ( y2 > text2_length )
-                {
-                    // Ran off the top of the graph.
-                    k2start += 2;
-                }
-                else if ( !front )
-                {
-                    auto k1_offset = v_offset + delta - k2;
-                    if ( ( k1_offset >= 0 ) && ( k1_offset < v_length ) && ( v1[ k1_offset ] != -1 ) )
-                    {
-                        auto x1 = v1[ k1_offset ];
-                        auto y1 = v_offset + x1 - k1_offset;
-                        // Mirror x2 onto top-left coordinate system.
-                        x2 = text1_length - v2[ k2_offset ];
-                        if ( x1 >= x2 )
-                        {
-                            // Overlap detected.
-                            return diff_bisectSplit( text1, text2, x1, y1, deadline );
-                        }
-                    }
-                }
-            }
+    TDiffVector diff_match_patch::diff_bisect( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline, SDiffContext &context )
+    {
+        if ( context.fStats )
+        {
+            context.fStats->fBisectCalls++;
+        }
+        std::size_t x = 0;
+        std::size_t y = 0;
+        if ( basic_diff_match_patch< wchar_t >::diff_bisect( text1, text2, deadline, x, y, context.fWorkspace ) )
+        {
+            // Found a middle snake, split the problem in two and recurse.
+            return diff_bisectSplit( text1, text2, x, y, deadline, context );
+        }
+        if ( context.fStats && context.fWorkspace.fHitDeadline )
+        {
+            context.fStats->fDeadlineAborts++;
         }
         // Diff took too long and hit the deadline or
         // number of diffs equals number of characters, no commonality at all.
         auto diffs = TDiffVector( { Diff( EOperation::eDELETE, text1 ), Diff( EOperation::eINSERT, text2 ) } );
+        if ( context.fProgress )
+            context.fProgress->settle( text1.length() + text2.length() );
         return diffs;
     }
 
-    TDiffVector diff_match_patch::diff_bisect( const std::string &text1, const std::string &text2, clock_t deadline )
+    TDiffVector diff_match_patch::diff_bisect( const std::string &text1, const std::string &text2, const SDeadline &deadline )
     {
         return diff_bisect( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), deadline );
     }
 
-    TDiffVector diff_match_patch::diff_bisectSplit( const std::wstring &text1, const std::wstring &text2, std::size_t x, std::size_t y, clock_t deadline )
+    TDiffVector diff_match_patch::diff_bisectSplit( std::wstring_view text1, std::wstring_view text2, std::size_t x, std::size_t y, const SDeadline &deadline, SDiffContext &context )
     {
+        // The split points stay views into the caller's buffers.
         auto text1a = text1.substr( 0, x );
         auto text2a = text2.substr( 0, y );
-        auto text1b = safeMid( text1, x );
-        auto text2b = safeMid( text2, y );
+        auto text1b = text1.substr( x );
+        auto text2b = text2.substr( y );
+
+        // The two halves are independent sub-problems.  When both halves are
+        // big enough to pay for a thread and the budget allows it, diff the
+        // second half on a worker while this thread takes the first.
+        constexpr std::size_t kMinParallelLength = 16 * 1024;
+        bool bothHalvesLarge = ( std::min( text1a.length(), text2a.length() ) >= kMinParallelLength ) && ( std::min( text1b.length(), text2b.length() ) >= kMinParallelLength );
+        if ( bothHalvesLarge && context.fThreadBudget )
+        {
+            if ( context.fThreadBudget->fetch_sub( 1 ) > 0 )
+            {
+                auto future = std::async( std::launch::async,
+                                          [ this, text1b, text2b, deadline, &context ]()
+                                          {
+                                              // Workers get a private workspace but share the budget.
+                                              SDiffContext workerContext( context.fThreadBudget );
+                                              return diff_main( text1b, text2b, false, deadline, workerContext );
+                                          } );
+                TDiffVector diffs = diff_main( text1a, text2a, false, deadline, context );
+                TDiffVector diffsb = future.get();
+                context.fThreadBudget->fetch_add( 1 );
+
+                diffs.insert( diffs.end(), diffsb.begin(), diffsb.end() );
+                return diffs;
+            }
+            // Lost the race for a thread; return the token.
+            context.fThreadBudget->fetch_add( 1 );
+        }
 
         // Compute both diffs serially.
-        TDiffVector diffs = diff_main( text1a, text2a, false, deadline );
-        TDiffVector diffsb = diff_main( text1b, text2b, false, deadline );
+        TDiffVector diffs = diff_main( text1a, text2a, false, deadline, context );
+        TDiffVector diffsb = diff_main( text1b, text2b, false, deadline, context );
 
         diffs.insert( diffs.end(), diffsb.begin(), diffsb.end() );
         return diffs;
     }
 
-    TDiffVector diff_match_patch::diff_bisectSplit( const std::string &text1, const std::string &text2, std::size_t x, std::size_t y, clock_t deadline )
+    TDiffVector diff_match_patch::diff_bisectSplit( const std::string &text1, const std::string &text2, std::size_t x, std::size_t y, const SDeadline &deadline, SDiffContext &context )
     {
-        return diff_bisectSplit( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), x, y, deadline );
+        return diff_bisectSplit( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ), x, y, deadline, context );
     }
 
     diff_match_patch::TVariantVector diff_match_patch::diff_linesToChars( const std::wstring &text1, const std::wstring &text2 )
@@ -733,206 +1170,295 @@ namespace NDiffMatchPatch
         return chars;
     }
 
-    void diff_match_patch::diff_charsToLines( TDiffVector &diffs, const TStringVector &lineArray )
+    diff_match_patch::SLineTokens diff_match_patch::diff_linesToTokens( const std::wstring &text1, const std::wstring &text2 )
     {
-        for ( auto &&diff : diffs )
-        {
-            std::wstring text;
-            for ( auto &&y : diff.text() )
-            {
-                text += lineArray[ y ];
-            }
-            diff.fText = text;
-        }
+        return diff_textToTokens( text1, text2, EDiffGranularity::eLINE );
     }
 
-    std::size_t diff_match_patch::diff_commonPrefix( const std::wstring &text1, const std::wstring &text2 )
+    diff_match_patch::SLineTokens diff_match_patch::diff_textToTokens( std::wstring_view text1, std::wstring_view text2, EDiffGranularity granularity )
     {
-        // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-        const auto n = std::min( text1.length(), text2.length() );
-        for ( std::size_t i = 0; i < n; i++ )
-        {
-            if ( text1[ i ] != text2[ i ] )
-            {
-                return i;
-            }
-        }
-        return n;
-    }
+        SLineTokens tokens;
+        std::unordered_map< std::wstring_view, uint32_t > lineHash;
+        // e.g. fLines[4] == L"Hello\n"
+        // e.g. lineHash[L"Hello\n"] == 4
 
-    std::size_t diff_match_patch::diff_commonPrefix( const std::string &text1, const std::string &text2 )
-    {
-        return diff_commonPrefix( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+        // Keep token 0 unused, mirroring the blank zeroth entry of
+        // diff_linesToChars.
+        tokens.fLines.emplace_back( std::wstring_view() );
+
+        tokens.fTokens1 = diff_textToTokensMunge( text1, granularity, tokens.fLines, lineHash );
+        tokens.fTokens2 = diff_textToTokensMunge( text2, granularity, tokens.fLines, lineHash );
+        return tokens;
     }
 
-    std::size_t diff_match_patch::diff_commonSuffix( const std::wstring &text1, const std::wstring &text2 )
+    std::u32string diff_match_patch::diff_textToTokensMunge( std::wstring_view text, EDiffGranularity granularity, TStringViewVector &lineArray, std::unordered_map< std::wstring_view, uint32_t > &lineHash )
     {
-        // Performance analysis: http://neil.fraser.name/news/2007/10/09/
-        const auto text1_length = text1.length();
-        const auto text2_length = text2.length();
-        const auto n = std::min( text1_length, text2_length );
-        for ( std::size_t i = 1; i <= n; i++ )
+        std::size_t lineStart = 0;
+        std::u32string tokens;
+        // Walk the text, taking a view of each token; the interned tokens
+        // stay views into the caller's text, so no token is ever copied here.
+        while ( lineStart < text.length() )
         {
-            if ( text1[ text1_length - i ] != text2[ text2_length - i ] )
+            auto lineEnd = diff_tokenEnd( text, lineStart, granularity );
+            auto line = text.substr( lineStart, lineEnd - lineStart );
+
+            auto pos = lineHash.find( line );
+            if ( pos != lineHash.end() )
+            {
+                tokens += static_cast< char32_t >( ( *pos ).second );
+            }
+            else
             {
-                return i - 1;
+                lineArray.emplace_back( line );
+                lineHash[ line ] = static_cast< uint32_t >( lineArray.size() - 1 );
+                tokens += static_cast< char32_t >( lineArray.size() - 1 );
             }
+
+            lineStart = lineEnd;
         }
-        return n;
+        return tokens;
     }
 
-    std::size_t diff_match_patch::diff_commonSuffix( const std::string &text1, const std::string &text2 )
+    std::size_t diff_match_patch::diff_tokenEnd( std::wstring_view text, std::size_t start, EDiffGranularity granularity )
     {
-        return diff_commonSuffix( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+        const auto length = text.length();
+        switch ( granularity )
+        {
+            case EDiffGranularity::eWORD:
+                {
+                    // A token is a run of non-whitespace with its trailing
+                    // whitespace attached (like lines keep their '\n'), so
+                    // only a token at the start of the text can be bare
+                    // whitespace.
+                    auto pos = start;
+                    while ( ( pos < length ) && !std::iswspace( text[ pos ] ) )
+                    {
+                        pos++;
+                    }
+                    while ( ( pos < length ) && std::iswspace( text[ pos ] ) )
+                    {
+                        pos++;
+                    }
+                    return pos;
+                }
+            case EDiffGranularity::eSENTENCE:
+                {
+                    // A sentence ends after a run of terminators ('.', '!',
+                    // '?') plus trailing whitespace, or after a newline.
+                    auto pos = start;
+                    while ( pos < length )
+                    {
+                        auto ch = text[ pos ];
+                        if ( ch == L'\n' )
+                        {
+                            return pos + 1;
+                        }
+                        if ( ( ch == L'.' ) || ( ch == L'!' ) || ( ch == L'?' ) )
+                        {
+                            pos++;
+                            while ( ( pos < length ) && ( ( text[ pos ] == L'.' ) || ( text[ pos ] == L'!' ) || ( text[ pos ] == L'?' ) ) )
+                            {
+                                pos++;
+                            }
+                            while ( ( pos < length ) && std::iswspace( text[ pos ] ) && ( text[ pos ] != L'\n' ) )
+                            {
+                                pos++;
+                            }
+                            return pos;
+                        }
+                        pos++;
+                    }
+                    return length;
+                }
+            case EDiffGranularity::eLINE:
+            default:
+                {
+                    auto pos = text.find( L'\n', start );
+                    return ( pos == std::wstring_view::npos ) ? length : ( pos + 1 );
+                }
+        }
     }
 
-    std::size_t diff_match_patch::diff_commonOverlap( const std::wstring &text1, const std::wstring &text2 )
+    TDiffVector diff_match_patch::diff_tokens( std::u32string_view tokens1, std::u32string_view tokens2, const TStringViewVector &lines, const SDeadline &deadline, SDiffContext &context )
     {
-        // Cache the text lengths to prevent multiple calls.
-        const auto text1_length = text1.length();
-        const auto text2_length = text2.length();
-        // Eliminate the nullptr case.
-        if ( text1_length == 0 || text2_length == 0 )
-        {
-            return 0;
-        }
-        // Truncate the longer string.
-        std::wstring text1_trunc = text1;
-        std::wstring text2_trunc = text2;
-        if ( text1_length > text2_length )
+        using TCore = basic_diff_match_patch< char32_t >;
+
+        // Check for equality (speedup).
+        TDiffVector diffs;
+        if ( tokens1 == tokens2 )
         {
-            text1_trunc = text1.substr( text1_length - text2_length );
+            if ( !tokens1.empty() )
+            {
+                diffs.emplace_back( EOperation::eEQUAL, diff_tokensToText( tokens1, lines ) );
+            }
+            return diffs;
         }
-        else if ( text1_length < text2_length )
+
+        // Trim off common prefix (speedup).
+        auto commonlength = TCore::diff_commonPrefix( tokens1, tokens2 );
+        auto commonprefix = tokens1.substr( 0, commonlength );
+        tokens1.remove_prefix( commonlength );
+        tokens2.remove_prefix( commonlength );
+
+        // Trim off common suffix (speedup).
+        commonlength = TCore::diff_commonSuffix( tokens1, tokens2 );
+        auto commonsuffix = tokens1.substr( tokens1.length() - commonlength );
+        tokens1.remove_suffix( commonlength );
+        tokens2.remove_suffix( commonlength );
+
+        // Compute the diff on the middle block.
+        diffs = diff_tokensCompute( tokens1, tokens2, lines, deadline, context );
+
+        // Restore the prefix and suffix.
+        if ( !commonprefix.empty() )
         {
-            text2_trunc = text2.substr( 0, text1_length );
+            diffs.emplace( diffs.begin(), EOperation::eEQUAL, diff_tokensToText( commonprefix, lines ) );
         }
-        const auto text_length = std::min( text1_length, text2_length );
-        // Quick check for the worst case.
-        if ( text1_trunc == text2_trunc )
+        if ( !commonsuffix.empty() )
         {
-            return text_length;
+            diffs.emplace_back( EOperation::eEQUAL, diff_tokensToText( commonsuffix, lines ) );
         }
 
-        // Start by looking for a single character match
-        // and increase length until no match is found.
-        // Performance analysis: http://neil.fraser.name/news/2010/11/04/
-        std::size_t best = 0;
-        std::size_t length = 1;
-        while ( true )
-        {
-            std::wstring pattern = ( length < text1_trunc.length() ) ? text1_trunc.substr( text_length - length ) : std::wstring();
-            if ( pattern.empty() )
-                return best;
+        diff_cleanupMerge( diffs );
 
-            auto found = text2_trunc.find( pattern );
-            if ( found == std::string::npos )
-            {
-                return best;
-            }
-            length += found;
-            if ( found == 0 || text1_trunc.substr( text_length - length ) == text2_trunc.substr( 0, length ) )
-            {
-                best = length;
-                length++;
-            }
-        }
+        return diffs;
     }
 
-    std::size_t diff_match_patch::diff_commonOverlap( const std::string &text1, const std::string &text2 )
+    TDiffVector diff_match_patch::diff_tokensCompute( std::u32string_view tokens1, std::u32string_view tokens2, const TStringViewVector &lines, const SDeadline &deadline, SDiffContext &context )
     {
-        return diff_commonOverlap( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
-    }
+        using TCore = basic_diff_match_patch< char32_t >;
 
-    diff_match_patch::TStringVector diff_match_patch::diff_halfMatch( const std::wstring &text1, const std::wstring &text2 )
-    {
-        if ( Diff_Timeout <= 0 )
+        TDiffVector diffs;
+        if ( tokens1.empty() )
         {
-            // Don't risk returning a non-optimal diff if we have unlimited time.
-            return {};
+            // Just add some text (speedup).
+            diffs.emplace_back( EOperation::eINSERT, diff_tokensToText( tokens2, lines ) );
+            return diffs;
         }
-        const std::wstring longtext = text1.length() > text2.length() ? text1 : text2;
-        const std::wstring shorttext = text1.length() > text2.length() ? text2 : text1;
-        if ( ( longtext.length() < 4 ) || ( ( shorttext.length() * 2 ) < longtext.length() ) )
+        if ( tokens2.empty() )
         {
-            return {};   // Pointless.
+            // Just delete some text (speedup).
+            diffs.emplace_back( EOperation::eDELETE, diff_tokensToText( tokens1, lines ) );
+            return diffs;
         }
 
-        // First check if the second quarter is the seed for a half-match.
-        const TStringVector hm1 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 3 ) / 4 );
-        // Check again based on the third quarter.
-        const TStringVector hm2 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 1 ) / 2 );
-        TStringVector hm;
-        if ( hm1.empty() && hm2.empty() )
+        if ( Diff_Timeout > 0 )
         {
-            return {};
+            // Same speedup as diff_compute: a shared half keeps the bisect
+            // problems small at the cost of a possibly non-optimal diff.
+            auto hm = TCore::diff_halfMatch( tokens1, tokens2 );
+            if ( !hm.empty() )
+            {
+                // Send both pairs off for separate processing.
+                diffs = diff_tokens( hm[ 0 ], hm[ 2 ], lines, deadline, context );
+                diffs.emplace_back( EOperation::eEQUAL, diff_tokensToText( hm[ 4 ], lines ) );
+                auto diffs_b = diff_tokens( hm[ 1 ], hm[ 3 ], lines, deadline, context );
+                diffs.insert( diffs.end(), diffs_b.begin(), diffs_b.end() );
+                return diffs;
+            }
         }
-        else if ( hm2.empty() )
+
+        std::size_t x = 0;
+        std::size_t y = 0;
+        if ( TCore::diff_bisect( tokens1, tokens2, deadline, x, y, context.fTokenWorkspace ) )
         {
-            hm = hm1;
+            // Found a middle snake, split the problem in two and recurse.
+            diffs = diff_tokens( tokens1.substr( 0, x ), tokens2.substr( 0, y ), lines, deadline, context );
+            auto diffs_b = diff_tokens( tokens1.substr( x ), tokens2.substr( y ), lines, deadline, context );
+            diffs.insert( diffs.end(), diffs_b.begin(), diffs_b.end() );
+            return diffs;
         }
-        else if ( hm1.empty() )
+        // Diff took too long and hit the deadline or
+        // number of diffs equals number of characters, no commonality at all.
+        diffs.emplace_back( EOperation::eDELETE, diff_tokensToText( tokens1, lines ) );
+        diffs.emplace_back( EOperation::eINSERT, diff_tokensToText( tokens2, lines ) );
+        return diffs;
+    }
+
+    std::wstring diff_match_patch::diff_tokensToText( std::u32string_view tokens, const TStringViewVector &lines )
+    {
+        std::wstring text;
+        std::size_t length = 0;
+        for ( auto &&token : tokens )
         {
-            hm = hm2;
+            length += lines[ static_cast< std::size_t >( token ) ].length();
         }
-        else
+        text.reserve( length );
+        for ( auto &&token : tokens )
         {
-            // Both matched.  Select the longest.
-            hm = hm1[ 4 ].length() > hm2[ 4 ].length() ? hm1 : hm2;
+            text += lines[ static_cast< std::size_t >( token ) ];
         }
+        return text;
+    }
 
-        // A half-match was found, sort out the return data.
-        if ( text1.length() > text2.length() )
-        {
-            return hm;
-        }
-        else
+    void diff_match_patch::diff_charsToLines( TDiffVector &diffs, const TStringVector &lineArray )
+    {
+        for ( auto &&diff : diffs )
         {
-            TStringVector listRet( { hm[ 2 ], hm[ 3 ], hm[ 0 ], hm[ 1 ], hm[ 4 ] } );
-            return listRet;
+            std::wstring text;
+            for ( auto &&y : diff.text() )
+            {
+                text += lineArray[ y ];
+            }
+            diff.fText = text;
         }
     }
 
-    diff_match_patch::TStringVector diff_match_patch::diff_halfMatch( const std::string &text1, const std::string &text2 )
+    std::size_t diff_match_patch::diff_commonPrefix( const std::wstring &text1, const std::wstring &text2 )
     {
-        return diff_halfMatch( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+        return basic_diff_match_patch< wchar_t >::diff_commonPrefix( text1, text2 );
+    }
+
+    std::size_t diff_match_patch::diff_commonPrefix( const std::string &text1, const std::string &text2 )
+    {
+        return diff_commonPrefix( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+    }
+
+    std::size_t diff_match_patch::diff_commonSuffix( const std::wstring &text1, const std::wstring &text2 )
+    {
+        return basic_diff_match_patch< wchar_t >::diff_commonSuffix( text1, text2 );
+    }
+
+    std::size_t diff_match_patch::diff_commonSuffix( const std::string &text1, const std::string &text2 )
+    {
+        return diff_commonSuffix( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+    }
+
+    std::size_t diff_match_patch::diff_commonOverlap( const std::wstring &text1, const std::wstring &text2 )
+    {
+        return basic_diff_match_patch< wchar_t >::diff_commonOverlap( text1, text2 );
     }
 
-    diff_match_patch::TStringVector diff_match_patch::diff_halfMatchI( const std::wstring &longtext, const std::wstring &shorttext, std::size_t i )
+    std::size_t diff_match_patch::diff_commonOverlap( const std::string &text1, const std::string &text2 )
+    {
+        return diff_commonOverlap( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
+    }
+
+    diff_match_patch::TStringVector diff_match_patch::diff_halfMatch( const std::wstring &text1, const std::wstring &text2 )
     {
-        // Start with a 1/4 length substring at position i as a seed.
-        const std::wstring seed = safeMid( longtext, i, longtext.length() / 4 );
-        std::size_t j = std::string::npos;
-        std::wstring best_common;
-        std::wstring best_longtext_a, best_longtext_b;
-        std::wstring best_shorttext_a, best_shorttext_b;
-        while ( ( j = shorttext.find( seed, j + 1 ) ) != std::string::npos )
+        if ( Diff_Timeout <= 0 )
         {
-            const auto prefixLength = diff_commonPrefix( safeMid( longtext, i ), safeMid( shorttext, j ) );
-            const auto suffixLength = diff_commonSuffix( longtext.substr( 0, i ), shorttext.substr( 0, j ) );
-            if ( best_common.length() < suffixLength + prefixLength )
-            {
-                best_common = safeMid( shorttext, j - suffixLength, suffixLength ) + safeMid( shorttext, j, prefixLength );
-                best_longtext_a = longtext.substr( 0, i - suffixLength );
-                best_longtext_b = safeMid( longtext, i + prefixLength );
-                best_shorttext_a = shorttext.substr( 0, j - suffixLength );
-                best_shorttext_b = safeMid( shorttext, j + prefixLength );
-            }
+            // Don't risk returning a non-optimal diff if we have unlimited time.
+            return {};
         }
-        if ( best_common.length() * 2 >= longtext.length() )
+        auto hm = basic_diff_match_patch< wchar_t >::diff_halfMatch( text1, text2 );
+        if ( hm.empty() )
         {
-            TStringVector listRet( { best_longtext_a, best_longtext_b, best_shorttext_a, best_shorttext_b, best_common } );
-            return listRet;
+            return {};
         }
-        else
+        // Materialize the views for the owning result type.
+        TStringVector listRet;
+        listRet.reserve( hm.size() );
+        for ( auto &&curr : hm )
         {
-            return {};
+            listRet.emplace_back( curr );
         }
+        return listRet;
     }
 
-    diff_match_patch::TStringVector diff_match_patch::diff_halfMatchI( const std::string &longtext, const std::string &shorttext, std::size_t i )
+    diff_match_patch::TStringVector diff_match_patch::diff_halfMatch( const std::string &text1, const std::string &text2 )
     {
-        return diff_halfMatchI( NUtils::to_wstring( longtext ), NUtils::to_wstring( shorttext ), i );
+        return diff_halfMatch( NUtils::to_wstring( text1 ), NUtils::to_wstring( text2 ) );
     }
 
     void diff_match_patch::diff_cleanupSemantic( TDiffVector &diffs )
@@ -941,63 +1467,69 @@ namespace NDiffMatchPatch
             return;
 
         bool changes = false;
-        // Stack of indices where equalities are found.
-        std::stack< std::size_t > equalities;   // stack of equalities
-        // Always equal to equalities[equalitiesLength-1][1]
+        // The backtracking loop runs on a list so each split is an O(1)
+        // splice instead of a mid-vector insert.
+        std::list< Diff > work( std::make_move_iterator( diffs.begin() ), std::make_move_iterator( diffs.end() ) );
+        // Stack of equalities found so far.
+        std::stack< std::list< Diff >::iterator > equalities;
+        // Always equal to equalities.top()->text()
         std::wstring lastEquality;
-        std::size_t pointer = 0;   // Index of current position.
         // Number of characters that changed prior to the equality.
         std::size_t length_insertions1 = 0;
         std::size_t length_deletions1 = 0;
         // Number of characters that changed after the equality.
         std::size_t length_insertions2 = 0;
         std::size_t length_deletions2 = 0;
-        while ( pointer < diffs.size() )
+        auto pointer = work.begin();
+        while ( pointer != work.end() )
         {
-            if ( diffs[ pointer ].isEqual() )
+            if ( pointer->isEqual() )
             {   // Equality found.
                 equalities.push( pointer );
                 length_insertions1 = length_insertions2;
                 length_deletions1 = length_deletions2;
                 length_insertions2 = 0;
                 length_deletions2 = 0;
-                lastEquality = diffs[ pointer ].text();
+                lastEquality = pointer->text();
             }
             else
             {   // an insertion or deletion
-                if ( diffs[ pointer ].isInsert() )
+                if ( pointer->isInsert() )
                 {
-                    length_insertions2 += diffs[ pointer ].text().length();
+                    length_insertions2 += pointer->text().length();
                 }
                 else
                 {
-                    length_deletions2 += diffs[ pointer ].text().length();
+                    length_deletions2 += pointer->text().length();
                 }
                 // Eliminate an equality that is smaller or equal to the edits on both
                 // sides of it.
                 if ( !lastEquality.empty() && ( lastEquality.length() <= std::max( length_insertions1, length_deletions1 ) ) && ( lastEquality.length() <= std::max( length_insertions2, length_deletions2 ) ) )
                 {
+                    auto equality = equalities.top();
                     // Duplicate record.
-                    diffs.insert( diffs.begin() + equalities.top(), Diff( EOperation::eDELETE, lastEquality ) );
+                    work.insert( equality, Diff( EOperation::eDELETE, lastEquality ) );
                     // Change second copy to insert.
-                    diffs[ equalities.top() + 1 ].fOperation = EOperation::eINSERT;
+                    equality->fOperation = EOperation::eINSERT;
                     // Throw away the equality we just deleted.
                     equalities.pop();
                     if ( !equalities.empty() )
                     {
                         equalities.pop();
                     }
-                    pointer = !equalities.empty() ? equalities.top() : -1;
+                    pointer = !equalities.empty() ? std::next( equalities.top() ) : work.begin();
                     length_insertions1 = 0;   // Reset the counters.
                     length_deletions1 = 0;
                     length_insertions2 = 0;
                     length_deletions2 = 0;
                     lastEquality.clear();
                     changes = true;
+                    continue;
                 }
             }
-            pointer++;
+            ++pointer;
         }
+        diffs.assign( std::make_move_iterator( work.begin() ), std::make_move_iterator( work.end() ) );
 
         // Normalize the diff.
         if ( changes )
@@ -1012,122 +1544,196 @@ namespace NDiffMatchPatch
         // e.g: <del>xxxabc</del><ins>defxxx</ins>
         //   -> <ins>def</ins>xxx<del>abc</del>
         // Only extract an overlap if it is as big as the edit ahead or behind it.
-        pointer = 1;
-        while ( pointer < diffs.size() )
-        {
-            if ( diffs[ pointer - 1 ].isDelete() && diffs[ pointer ].isInsert() )
+        // The result is built front to back into a fresh vector so each
+        // extracted equality is appended rather than inserted mid-vector.
+        if ( !diffs.empty() )
+        {
+            TDiffVector extracted;
+            extracted.reserve( diffs.size() );
+            extracted.emplace_back( std::move( diffs[ 0 ] ) );
+            for ( std::size_t ii = 1; ii < diffs.size(); ++ii )
             {
-                auto deletion = diffs[ pointer - 1 ].text();
-                auto insertion = diffs[ pointer ].text();
-                std::size_t overlap_length1 = diff_commonOverlap( deletion, insertion );
-                std::size_t overlap_length2 = diff_commonOverlap( insertion, deletion );
-                if ( overlap_length1 >= overlap_length2 )
+                auto &&current = diffs[ ii ];
+                if ( extracted.back().isDelete() && current.isInsert() )
                 {
-                    if ( overlap_length1 >= deletion.length() / 2.0 || overlap_length1 >= insertion.length() / 2.0 )
+                    auto deletion = extracted.back().text();
+                    auto insertion = current.text();
+                    std::size_t overlap_length1 = diff_commonOverlap( deletion, insertion );
+                    std::size_t overlap_length2 = diff_commonOverlap( insertion, deletion );
+                    if ( overlap_length1 >= overlap_length2 )
                     {
-                        // Overlap found.
-                        // Insert an equality and trim the surrounding edits.
-                        diffs.emplace( diffs.begin() + pointer, EOperation::eEQUAL, insertion.substr( 0, overlap_length1 ) );
-                        diffs[ pointer - 1 ].fText = deletion.substr( 0, deletion.length() - overlap_length1 );
-                        diffs[ pointer + 1 ].fText = insertion.substr( overlap_length1 );
-                        pointer++;
+                        if ( overlap_length1 >= deletion.length() / 2.0 || overlap_length1 >= insertion.length() / 2.0 )
+                        {
+                            // Overlap found.
+                            // Insert an equality and trim the surrounding edits.
+                            extracted.back().fText = deletion.substr( 0, deletion.length() - overlap_length1 );
+                            extracted.emplace_back( EOperation::eEQUAL, insertion.substr( 0, overlap_length1 ) );
+                            extracted.emplace_back( EOperation::eINSERT, insertion.substr( overlap_length1 ) );
+                            continue;
+                        }
                     }
-                }
-                else
-                {
-                    if ( overlap_length2 >= deletion.length() / 2.0 || overlap_length2 >= insertion.length() / 2.0 )
+                    else
                     {
-                        // Reverse overlap found.
-                        // Insert an equality and swap and trim the surrounding edits.
-                        diffs.emplace( diffs.begin() + pointer, EOperation::eEQUAL, deletion.substr( 0, overlap_length2 ) );
-                        diffs[ pointer - 1 ].fOperation = EOperation::eINSERT;
-                        diffs[ pointer - 1 ].fText = insertion.substr( 0, insertion.length() - overlap_length2 );
-                        diffs[ pointer + 1 ].fOperation = EOperation::eDELETE;
-                        diffs[ pointer + 1 ].fText = deletion.substr( overlap_length2 );
-                        pointer++;
+                        if ( overlap_length2 >= deletion.length() / 2.0 || overlap_length2 >= insertion.length() / 2.0 )
+                        {
+                            // Reverse overlap found.
+                            // Insert an equality and swap and trim the surrounding edits.
+                            extracted.back().fOperation = EOperation::eINSERT;
+                            extracted.back().fText = insertion.substr( 0, insertion.length() - overlap_length2 );
+                            extracted.emplace_back( EOperation::eEQUAL, deletion.substr( 0, overlap_length2 ) );
+                            extracted.emplace_back( EOperation::eDELETE, deletion.substr( overlap_length2 ) );
+                            continue;
+                        }
                     }
                 }
-                pointer++;
+                extracted.emplace_back( std::move( current ) );
             }
-            pointer++;
+            diffs = std::move( extracted );
         }
     }
 
     void diff_match_patch::diff_cleanupSemanticLossless( TDiffVector &diffs )
     {
-        int pointer = 1;
+        // Emptied equalities are tombstoned and compacted once at the end
+        // instead of being erased mid-vector.
+        std::vector< bool > removed( diffs.size(), false );
+        std::vector< std::size_t > live;   // entries before pointer still alive
+        bool removedAny = false;
+        if ( !diffs.empty() )
+        {
+            live.push_back( 0 );
+        }
+        std::size_t pointer = 1;
         // Intentionally ignore the first and last element (don't need checking).
-        while ( ( pointer != -1 ) && !diffs.empty() && ( pointer < ( diffs.size() - 1 ) ) )
+        while ( !diffs.empty() && ( ( pointer + 1 ) < diffs.size() ) )
         {
-            if ( diffs[ pointer - 1 ].isEqual() && diffs[ pointer + 1 ].isEqual() )
+            auto next = pointer + 1;
+            while ( ( next < diffs.size() ) && removed[ next ] )
             {
-                // This is a single edit surrounded by equalities.
-                auto equality1 = diffs[ pointer - 1 ].text();
-                auto edit = diffs[ pointer ].text();
-                auto equality2 = diffs[ pointer + 1 ].text();
+                next++;
+            }
+            if ( next >= diffs.size() )
+            {
+                break;
+            }
+            if ( !live.empty() && diffs[ live.back() ].isEqual() && diffs[ next ].isEqual() )
+            {
+                auto prev = live.back();
+                // This is a single edit surrounded by equalities.  Every
+                // candidate alignment is a slice of the same concatenation,
+                // so build it once and slide the two boundaries over it
+                // instead of rebuilding three strings per step.
+                const auto whole = diffs[ prev ].text() + diffs[ pointer ].text() + diffs[ next ].text();
+                const auto view = std::wstring_view( whole );
+                const auto editLength = diffs[ pointer ].text().length();
 
                 // First, shift the edit as far left as possible.
-                auto commonOffset = diff_commonSuffix( equality1, edit );
-                if ( commonOffset > 0 )
-                {
-                    auto commonString = safeMid( edit, edit.length() - commonOffset );
-                    equality1 = equality1.substr( 0, equality1.length() - commonOffset );
-                    edit = commonString + edit.substr( 0, edit.length() - commonOffset );
-                    equality2 = commonString + equality2;
-                }
+                auto editStart = diffs[ prev ].text().length();
+                editStart -= diff_commonSuffix( diffs[ prev ].text(), diffs[ pointer ].text() );
 
                 // Second, step character by character right,
                 // looking for the best fit.
-                auto bestEquality1 = equality1;
-                auto bestEdit = edit;
-                auto bestEquality2 = equality2;
+                auto bestStart = editStart;
+                auto equality1 = view.substr( 0, editStart );
+                auto edit = view.substr( editStart, editLength );
+                auto equality2 = view.substr( editStart + editLength );
                 auto bestScore = diff_cleanupSemanticScore( equality1, edit ) + diff_cleanupSemanticScore( edit, equality2 );
                 while ( !edit.empty() && !equality2.empty() && edit[ 0 ] == equality2[ 0 ] )
                 {
-                    equality1 += edit[ 0 ];
-                    edit = edit.substr( 1 ) + equality2[ 0 ];
-                    equality2 = equality2.substr( 1 );
+                    editStart++;
+                    equality1 = view.substr( 0, editStart );
+                    edit = view.substr( editStart, editLength );
+                    equality2 = view.substr( editStart + editLength );
                     auto score = diff_cleanupSemanticScore( equality1, edit ) + diff_cleanupSemanticScore( edit, equality2 );
                     // The >= encourages trailing rather than leading whitespace on
                     // edits.
                     if ( score >= bestScore )
                     {
                         bestScore = score;
-                        bestEquality1 = equality1;
-                        bestEdit = edit;
-                        bestEquality2 = equality2;
+                        bestStart = editStart;
                     }
                 }
 
-                if ( diffs[ pointer - 1 ].text() != bestEquality1 )
+                auto bestEquality1 = std::wstring( view.substr( 0, bestStart ) );
+                auto bestEdit = std::wstring( view.substr( bestStart, editLength ) );
+                auto bestEquality2 = std::wstring( view.substr( bestStart + editLength ) );
+                if ( diffs[ prev ].text() != bestEquality1 )
                 {
                     // We have an improvement, save it back to the diff.
                     if ( !bestEquality1.empty() )
                     {
-                        diffs[ pointer - 1 ].fText = bestEquality1;
+                        diffs[ prev ].fText = bestEquality1;
                     }
                     else
                     {
-                        diffs.erase( diffs.begin() + pointer - 1 );
-                        pointer--;
+                        removed[ prev ] = true;
+                        live.pop_back();
+                        removedAny = true;
                     }
                     diffs[ pointer ].fText = bestEdit;
                     if ( !bestEquality2.empty() )
                     {
-                        diffs[ pointer + 1 ].fText = bestEquality2;
+                        diffs[ next ].fText = bestEquality2;
                     }
                     else
                     {
-                        diffs.erase( diffs.begin() + pointer + 1 );
-                        pointer--;
+                        removed[ next ] = true;
+                        removedAny = true;
+                        // Re-examine this edit against the following entry.
+                        continue;
+                    }
+                }
+            }
+            live.push_back( pointer );
+            pointer = next;
+        }
+        if ( removedAny )
+        {
+            std::size_t liveCount = 0;
+            for ( std::size_t ii = 0; ii < diffs.size(); ++ii )
+            {
+                if ( !removed[ ii ] )
+                {
+                    if ( liveCount != ii )
+                    {
+                        diffs[ liveCount ] = std::move( diffs[ ii ] );
                     }
+                    liveCount++;
                 }
             }
-            pointer++;
+            diffs.resize( liveCount );
+        }
+    }
+
+    namespace
+    {
+        // Direct equivalents of the boundary regexes (\n\r?\n$ and ^\r?\n\r?\n)
+        // that used to live here; plain character checks keep the semantic
+        // alignment loop off the std::wregex machinery.
+        bool endsWithBlankLine( std::wstring_view text )
+        {
+            auto len = text.length();
+            if ( ( len >= 2 ) && ( text[ len - 1 ] == L'\n' ) && ( text[ len - 2 ] == L'\n' ) )
+                return true;
+            return ( len >= 3 ) && ( text[ len - 1 ] == L'\n' ) && ( text[ len - 2 ] == L'\r' ) && ( text[ len - 3 ] == L'\n' );
+        }
+
+        bool startsWithBlankLine( std::wstring_view text )
+        {
+            auto pos = 0ULL;
+            for ( auto lineBreaks = 0; lineBreaks < 2; ++lineBreaks )
+            {
+                if ( ( pos < text.length() ) && ( text[ pos ] == L'\r' ) )
+                    pos++;
+                if ( ( pos >= text.length() ) || ( text[ pos ] != L'\n' ) )
+                    return false;
+                pos++;
+            }
+            return true;
         }
     }
 
-    int64_t diff_match_patch::diff_cleanupSemanticScore( const std::wstring &one, const std::wstring &two )
+    int64_t diff_match_patch::diff_cleanupSemanticScore( std::wstring_view one, std::wstring_view two )
     {
         if ( one.empty() || two.empty() )
         {
@@ -1148,8 +1754,8 @@ namespace NDiffMatchPatch
         bool whitespace2 = nonAlphaNumeric2 && std::iswspace( char2 );
         bool lineBreak1 = whitespace1 && std::iswcntrl( char1 );
         bool lineBreak2 = whitespace2 && std::iswcntrl( char2 );
-        bool blankLine1 = lineBreak1 && std::regex_search( one, BLANKLINEEND );
-        bool blankLine2 = lineBreak2 && std::regex_search( two, BLANKLINESTART );
+        bool blankLine1 = lineBreak1 && endsWithBlankLine( one );
+        bool blankLine2 = lineBreak2 && startsWithBlankLine( two );
 
         if ( blankLine1 || blankLine2 )
         {
@@ -1184,18 +1790,16 @@ namespace NDiffMatchPatch
         return diff_cleanupSemanticScore( NUtils::to_wstring( one ), NUtils::to_wstring( two ) );
     }
 
-    // Define some regex patterns for matching boundaries.
-    std::wregex diff_match_patch::BLANKLINEEND = std::wregex( LR"(\n\r?\n$)" );
-    std::wregex diff_match_patch::BLANKLINESTART = std::wregex( LR"(^\r?\n\r?\n)" );
-
     void diff_match_patch::diff_cleanupEfficiency( TDiffVector &diffs )
     {
         bool changes = false;
-        // Stack of indices where equalities are found.
-        std::stack< std::size_t > equalities;
-        // Always equal to equalities[equalitiesLength-1][1]
+        // The backtracking loop runs on a list so each duplicated record is
+        // an O(1) splice instead of a mid-vector insert.
+        std::list< Diff > work( std::make_move_iterator( diffs.begin() ), std::make_move_iterator( diffs.end() ) );
+        // Stack of equalities found so far.
+        std::stack< std::list< Diff >::iterator > equalities;
+        // Always equal to equalities.top()->text()
         std::wstring lastEquality;
-        std::size_t pointer = 0;   // Index of current position.
         // Is there an insertion operation before the last equality.
         bool pre_ins = false;
         // Is there a deletion operation before the last equality.
@@ -1204,17 +1808,18 @@ namespace NDiffMatchPatch
         bool post_ins = false;
         // Is there a deletion operation after the last equality.
         bool post_del = false;
-        while ( pointer < diffs.size() )
+        auto pointer = work.begin();
+        while ( pointer != work.end() )
         {
-            if ( diffs[ pointer ].isEqual() )
+            if ( pointer->isEqual() )
             {   // Equality found.
-                if ( diffs[ pointer ].text().length() < Diff_EditCost && ( post_ins || post_del ) )
+                if ( ( pointer->text().length() < Diff_EditCost ) && ( post_ins || post_del ) )
                 {
                     // Candidate found.
                     equalities.push( pointer );
                     pre_ins = post_ins;
                     pre_del = post_del;
-                    lastEquality = diffs[ pointer ].text();
+                    lastEquality = pointer->text();
                 }
                 else
                 {
@@ -1226,7 +1831,7 @@ namespace NDiffMatchPatch
             }
             else
             {   // An insertion or deletion.
-                if ( diffs[ pointer ].isDelete() )
+                if ( pointer->isDelete() )
                 {
                     post_del = true;
                 }
@@ -1244,12 +1849,14 @@ namespace NDiffMatchPatch
        */
                 if ( ( lastEquality.length() != 0 ) && ( ( pre_ins && pre_del && post_ins && post_del ) || ( ( lastEquality.length() < Diff_EditCost / 2 ) && ( ( pre_ins ? 1 : 0 ) + ( pre_del ? 1 : 0 ) + ( post_ins ? 1 : 0 ) + ( post_del ? 1 : 0 ) ) == 3 ) ) )
                 {
+                    auto equality = equalities.top();
                     // Duplicate record.
-                    diffs.emplace( diffs.begin() + equalities.top(), EOperation::eDELETE, lastEquality );
+                    work.insert( equality, Diff( EOperation::eDELETE, lastEquality ) );
                     // Change second copy to insert.
-                    diffs[ equalities.top() + 1 ].fOperation = EOperation::eINSERT;
+                    equality->fOperation = EOperation::eINSERT;
                     equalities.pop();   // Throw away the equality we just deleted.
                     lastEquality.clear();
+                    changes = true;
                     if ( pre_ins && pre_del )
                     {
                         // No changes made which could affect previous entry, keep going.
@@ -1263,14 +1870,15 @@ namespace NDiffMatchPatch
                             equalities.pop();
                         }
 
-                        pointer = !equalities.empty() ? equalities.top() : -1;
+                        pointer = !equalities.empty() ? std::next( equalities.top() ) : work.begin();
                         post_ins = post_del = false;
+                        continue;
                     }
-                    changes = true;
                 }
             }
-            pointer++;
+            ++pointer;
         }
+        diffs.assign( std::make_move_iterator( work.begin() ), std::make_move_iterator( work.end() ) );
 
         if ( changes )
         {
@@ -1280,128 +1888,156 @@ namespace NDiffMatchPatch
 
     void diff_match_patch::diff_cleanupMerge( TDiffVector &diffs )
     {
-        diffs.emplace_back( EOperation::eEQUAL, L"" );
-        int pointer = 0;
+        diffs.emplace_back( EOperation::eEQUAL, L"" );   // Add a dummy entry at the end.
+
+        // First pass: reorder and merge like edit sections, factoring out any
+        // commonalities a paired delete/insert run shares into the
+        // surrounding equalities.  The output is built front to back into a
+        // fresh vector, so the pass is O(n); the old Splice-based loop erased
+        // and inserted mid-vector and went quadratic on diffs with very many
+        // hunks.
+        TDiffVector merged;
+        merged.reserve( diffs.size() );
         int count_delete = 0;
         int count_insert = 0;
         std::wstring text_delete;
         std::wstring text_insert;
-
-        while ( pointer < diffs.size() )
+        for ( auto &&aDiff : diffs )
         {
-            if ( diffs[ pointer ].isInsert() )
+            if ( aDiff.isInsert() )
             {
                 count_insert++;
-                text_insert += diffs[ pointer ].text();
-                pointer++;
+                text_insert += aDiff.text();
+                continue;
             }
-            else if ( diffs[ pointer ].isDelete() )
+            if ( aDiff.isDelete() )
             {
                 count_delete++;
-                text_delete += diffs[ pointer ].text();
-                pointer++;
+                text_delete += aDiff.text();
+                continue;
             }
-            else if ( diffs[ pointer ].isEqual() )
+
+            // Upon reaching an equality, check for prior redundancies.
+            auto equalityText = aDiff.text();
+            if ( ( count_delete + count_insert ) > 1 )
             {
-                // Upon reaching an equality, check for prior redundancies.
-                if ( count_delete + count_insert > 1 )
+                if ( ( count_delete != 0 ) && ( count_insert != 0 ) )
                 {
-                    if ( count_delete != 0 && count_insert != 0 )
+                    // Factor out any common prefixies.
+                    auto commonlength = diff_commonPrefix( text_insert, text_delete );
+                    if ( commonlength != 0 )
                     {
-                        // Factor out any common prefixies.
-                        auto commonlength = diff_commonPrefix( text_insert, text_delete );
-                        if ( commonlength != 0 )
+                        if ( !merged.empty() && merged.back().isEqual() )
                         {
-                            if ( ( pointer > ( count_delete + count_insert ) ) && diffs[ pointer - ( count_delete + count_insert ) - 1 ].isEqual() )
-                            {
-                                diffs[ pointer - count_delete - count_insert - 1 ].fText += text_insert.substr( 0, commonlength );
-                            }
-                            else
-                            {
-                                diffs.emplace( diffs.begin(), EOperation::eEQUAL, text_insert.substr( 0, commonlength ) );
-                                pointer++;
-                            }
-                            text_insert = text_insert.substr( commonlength );
-                            text_delete = text_delete.substr( commonlength );
+                            merged.back().fText += text_insert.substr( 0, commonlength );
                         }
-                        // Factor out any common suffixies.
-                        commonlength = diff_commonSuffix( text_insert, text_delete );
-                        if ( commonlength != 0 )
+                        else
                         {
-                            diffs[ pointer ].fText = safeMid( text_insert, text_insert.length() - commonlength ) + diffs[ pointer ].text();
-                            text_insert = text_insert.substr( 0, text_insert.length() - commonlength );
-                            text_delete = text_delete.substr( 0, text_delete.length() - commonlength );
+                            merged.emplace_back( EOperation::eEQUAL, text_insert.substr( 0, commonlength ) );
                         }
+                        text_insert = text_insert.substr( commonlength );
+                        text_delete = text_delete.substr( commonlength );
                     }
-                    // Delete the offending records and add the merged ones.
-                    pointer -= count_delete + count_insert;
-                    NUtils::Splice( diffs, pointer, count_delete + count_insert );
-                    if ( !text_delete.empty() )
-                    {
-                        NUtils::Splice( diffs, pointer, 0, { Diff( EOperation::eDELETE, text_delete ) } );
-                        pointer++;
-                    }
-                    if ( !text_insert.empty() )
+                    // Factor out any common suffixies.
+                    commonlength = diff_commonSuffix( text_insert, text_delete );
+                    if ( commonlength != 0 )
                     {
-                        NUtils::Splice( diffs, pointer, 0, { Diff( EOperation::eINSERT, text_insert ) } );
-                        pointer++;
+                        equalityText = safeMid( text_insert, text_insert.length() - commonlength ) + equalityText;
+                        text_insert = text_insert.substr( 0, text_insert.length() - commonlength );
+                        text_delete = text_delete.substr( 0, text_delete.length() - commonlength );
                     }
-                    pointer++;
                 }
-                else if ( pointer != 0 && diffs[ pointer - 1 ].isEqual() )
+                // Add the merged records.
+                if ( !text_delete.empty() )
                 {
-                    // Merge this equality with the previous one.
-                    diffs[ pointer - 1 ].fText += diffs[ pointer ].text();
-                    diffs.erase( diffs.begin() + pointer );
+                    merged.emplace_back( EOperation::eDELETE, text_delete );
                 }
-                else
+                if ( !text_insert.empty() )
                 {
-                    pointer++;
+                    merged.emplace_back( EOperation::eINSERT, text_insert );
                 }
-                count_insert = 0;
-                count_delete = 0;
-                text_delete.clear();
-                text_insert.clear();
+                merged.emplace_back( EOperation::eEQUAL, equalityText );
             }
+            else if ( ( count_delete + count_insert ) == 1 )
+            {
+                // A lone edit passes through unchanged.
+                merged.emplace_back( ( count_delete != 0 ) ? EOperation::eDELETE : EOperation::eINSERT, ( count_delete != 0 ) ? text_delete : text_insert );
+                merged.emplace_back( EOperation::eEQUAL, equalityText );
+            }
+            else if ( !merged.empty() && merged.back().isEqual() )
+            {
+                // Merge this equality with the previous one.
+                merged.back().fText += equalityText;
+            }
+            else
+            {
+                merged.emplace_back( EOperation::eEQUAL, equalityText );
+            }
+            count_insert = 0;
+            count_delete = 0;
+            text_delete.clear();
+            text_insert.clear();
         }
-        if ( diffs.back().text().empty() )
+        if ( !merged.empty() && merged.back().text().empty() )
         {
-            diffs.pop_back();   // Remove the dummy entry at the end.
+            merged.pop_back();   // Remove the dummy entry at the end.
         }
+        diffs = std::move( merged );
 
         // Second pass: look for single edits surrounded on both sides by
         // equalities which can be shifted sideways to eliminate an equality.
         // e.g: A<ins>BA</ins>C -> <ins>AB</ins>AC
+        // Eliminated equalities are tombstoned and compacted once at the end
+        // instead of being erased mid-vector.
         bool changes = false;
-        pointer = 1;
+        std::vector< bool > removed( diffs.size(), false );
+        std::size_t prev = 0;   // Last entry before pointer not yet tombstoned.
+        std::size_t pointer = 1;
         // Intentionally ignore the first and last element (don't need checking).
-        while ( !diffs.empty() && pointer < ( diffs.size() - 1 ) )
+        while ( !diffs.empty() && ( ( pointer + 1 ) < diffs.size() ) )
         {
-            if ( diffs[ pointer - 1 ].isEqual() && diffs[ pointer + 1 ].isEqual() )
+            if ( diffs[ prev ].isEqual() && diffs[ pointer + 1 ].isEqual() )
             {
                 // This is a single edit surrounded by equalities.
-                if ( NUtils::endsWith( diffs[ pointer ].text(), diffs[ pointer - 1 ].text() ) )
+                if ( NUtils::endsWith( diffs[ pointer ].text(), diffs[ prev ].text() ) )
                 {
                     // Shift the edit over the previous equality.
-                    diffs[ pointer ].fText = diffs[ pointer - 1 ].text() + diffs[ pointer ].text().substr( 0, diffs[ pointer ].text().length() - diffs[ pointer - 1 ].text().length() );
-                    diffs[ pointer + 1 ].fText = diffs[ pointer - 1 ].text() + diffs[ pointer + 1 ].text();
-                    NUtils::Splice( diffs, pointer - 1, 1 );
+                    diffs[ pointer ].fText = diffs[ prev ].text() + diffs[ pointer ].text().substr( 0, diffs[ pointer ].text().length() - diffs[ prev ].text().length() );
+                    diffs[ pointer + 1 ].fText = diffs[ prev ].text() + diffs[ pointer + 1 ].text();
+                    removed[ prev ] = true;
                     changes = true;
                 }
                 else if ( diffs[ pointer ].text().find( diffs[ pointer + 1 ].text() ) == 0 )
                 {
                     // Shift the edit over the next equality.
-                    diffs[ pointer - 1 ].fText += diffs[ pointer + 1 ].text();
+                    diffs[ prev ].fText += diffs[ pointer + 1 ].text();
                     diffs[ pointer ].fText = diffs[ pointer ].text().substr( diffs[ pointer + 1 ].text().length() ) + diffs[ pointer + 1 ].text();
-                    NUtils::Splice( diffs, pointer + 1, 1 );
+                    removed[ pointer + 1 ] = true;
                     changes = true;
                 }
             }
+            if ( !removed[ pointer ] )
+            {
+                prev = pointer;
+            }
             pointer++;
         }
         // If shifts were made, the diff needs reordering and another shift sweep.
         if ( changes )
         {
+            std::size_t live = 0;
+            for ( std::size_t ii = 0; ii < diffs.size(); ++ii )
+            {
+                if ( !removed[ ii ] )
+                {
+                    if ( live != ii )
+                    {
+                        diffs[ live ] = std::move( diffs[ ii ] );
+                    }
+                    live++;
+                }
+            }
+            diffs.resize( live );
             diff_cleanupMerge( diffs );
         }
     }
@@ -1444,24 +2080,53 @@ namespace NDiffMatchPatch
 
     std::wstring diff_match_patch::diff_prettyHtml( const TDiffVector &diffs )
     {
+        // Size the report once so the per-diff appends never reallocate.
+        std::size_t total = 0;
+        for ( auto &&aDiff : diffs )
+        {
+            total += aDiff.text().length() + 64;
+        }
         std::wstring html;
+        html.reserve( total );
         for ( auto &&aDiff : diffs )
         {
-            html += aDiff.toHtml();
+            aDiff.toHtml( html );
         }
         return html;
     }
 
+    void diff_match_patch::diff_prettyHtml( const TDiffVector &diffs, std::wostream &out )
+    {
+        for ( auto &&aDiff : diffs )
+        {
+            aDiff.toHtml( out );
+        }
+    }
+
     std::wstring diff_match_patch::diff_prettyConsole( const TDiffVector &diffs )
     {
+        std::size_t total = 0;
+        for ( auto &&aDiff : diffs )
+        {
+            total += aDiff.text().length() + 16;
+        }
         std::wstring retVal;
+        retVal.reserve( total );
         for ( auto &&aDiff : diffs )
         {
-            retVal += aDiff.toConsole();
+            aDiff.toConsole( retVal );
         }
         return retVal;
     }
 
+    void diff_match_patch::diff_prettyConsole( const TDiffVector &diffs, std::wostream &out )
+    {
+        for ( auto &&aDiff : diffs )
+        {
+            aDiff.toConsole( out );
+        }
+    }
+
     std::wstring diff_match_patch::diff_text1( const TDiffVector &diffs )
     {
         std::wstring text;
@@ -1514,14 +2179,32 @@ namespace NDiffMatchPatch
     std::wstring diff_match_patch::diff_toDelta( const TDiffVector &diffs )
     {
         std::wstring text;
+        // Reserve for the worst case (every insert character percent-encoded
+        // to three bytes) so the writer appends into a single allocation.
+        std::size_t estimate = 0;
+        for ( auto &&aDiff : diffs )
+        {
+            estimate += 2 + ( aDiff.isInsert() ? aDiff.text().length() * 3 : 20 );
+        }
+        text.reserve( estimate );
         for ( auto &&aDiff : diffs )
         {
-            text += aDiff.toDelta();
+            if ( aDiff.isInsert() )
+            {
+                text += L'+';
+                text += NUtils::toPercentEncoding( aDiff.text(), L" !~*'();/?:@&=+$,#" );
+            }
+            else
+            {
+                text += aDiff.isDelete() ? L'-' : L'=';
+                text += std::to_wstring( aDiff.text().length() );
+            }
+            text += L'\t';
         }
         if ( !text.empty() )
         {
             // Strip off trailing tab character.
-            text = text.substr( 0, text.length() - 1 );
+            text.pop_back();
         }
         return text;
     }
@@ -1530,9 +2213,14 @@ namespace NDiffMatchPatch
     {
         TDiffVector diffs;
         std::size_t pointer = 0;   // Cursor in text1
-        auto tokens = NUtils::splitString( delta, L"\t", false );
-        for ( auto &&token : tokens )
-        {
+        // Stream over the delta one tab-separated token at a time instead of
+        // materializing a vector of all tokens.
+        std::wstring_view remaining( delta );
+        while ( !remaining.empty() )
+        {
+            auto tabPos = remaining.find( L'\t' );
+            auto token = remaining.substr( 0, tabPos );
+            remaining.remove_prefix( ( tabPos == std::wstring_view::npos ) ? remaining.length() : tabPos + 1 );
             if ( token.empty() )
             {
                 // Blank tokens are ok (from a trailing \t).
@@ -1540,13 +2228,12 @@ namespace NDiffMatchPatch
             }
             // Each token begins with a one character parameter which specifies the
             // operation of this token (delete, insert, equality).
-            std::wstring param = safeMid( token, 1 );
+            auto param = token.substr( 1 );
             switch ( token[ 0 ] )
             {
                 case '+':
-                    NUtils::replace( param, L"+", L"%2b" );
-                    param = NUtils::fromPercentEncoding( param );
-                    diffs.emplace_back( EOperation::eINSERT, param );
+                    // A literal '+' in an insert hunk must stay a '+'.
+                    diffs.emplace_back( EOperation::eINSERT, NUtils::fromPercentEncoding( param, true ) );
                     break;
                 case '-':
                     // Fall through.
@@ -1555,7 +2242,7 @@ namespace NDiffMatchPatch
                         auto n = NUtils::toInt( param );
                         if ( n < 0 )
                         {
-                            throw std::wstring( L"Negative number in diff_fromDelta: " + param );
+                            throw std::wstring( L"Negative number in diff_fromDelta: " ) + std::wstring( param );
                         }
                         std::wstring text;
                         if ( ( pointer + n ) > text1.length() )
@@ -1626,41 +2313,159 @@ namespace NDiffMatchPatch
         return match_main( NUtils::to_wstring( text ), NUtils::to_wstring( pattern ), loc );
     }
 
+    std::size_t diff_match_patch::match_main( const std::wstring &text, const std::wstring &pattern, std::size_t loc, const SOptions &options ) const
+    {
+        diff_match_patch engine( options );
+        return engine.match_main( text, pattern, loc );
+    }
+
     std::size_t diff_match_patch::match_bitap( const std::wstring &text, const std::wstring &pattern, std::size_t loc )
     {
-        if ( !( Match_MaxBits == 0 || pattern.length() <= Match_MaxBits ) )
+        return match_bitap( text, SMatchPattern( pattern ), loc );
+    }
+
+    std::size_t diff_match_patch::match_bitap( const std::string &text, const std::string &pattern, std::size_t loc )
+    {
+        return match_bitap( NUtils::to_wstring( text ), NUtils::to_wstring( pattern ), loc );
+    }
+
+    double diff_match_patch::match_bitapScore( int64_t e, int64_t x, int64_t loc, const std::wstring &pattern )
+    {
+        const float accuracy = static_cast< float >( e ) / pattern.length();
+        const auto proximity = std::abs( loc - x );
+        if ( Match_Distance == 0 )
+        {
+            // Dodge divide by zero error.
+            return proximity == 0 ? accuracy : 1.0;
+        }
+        return accuracy + ( proximity / static_cast< float >( Match_Distance ) );
+    }
+
+    diff_match_patch::TCharPosMap diff_match_patch::match_alphabet( const std::wstring &pattern )
+    {
+        TCharPosMap s;
+        std::size_t i;
+        for ( i = 0; i < pattern.length(); i++ )
+        {
+            auto c = pattern[ i ];
+            s[ c ] = 0;
+        }
+        for ( i = 0; i < pattern.length(); i++ )
+        {
+            auto c = pattern[ i ];
+            auto pos = s.find( c );
+            std::size_t prev = 0;
+            if ( pos != s.end() )
+                prev = ( *pos ).second;
+            s[ c ] = prev | ( 1ULL << ( pattern.length() - i - 1 ) );
+        }
+        return s;
+    }
+
+    diff_match_patch::TCharPosMap diff_match_patch::match_alphabet( const std::string &pattern )
+    {
+        return match_alphabet( NUtils::to_wstring( pattern ) );
+    }
+
+    std::size_t diff_match_patch::match_main( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc )
+    {
+        loc = std::max( kZERO, std::min( loc, text.length() ) );
+        if ( text == pattern.fPattern )
+        {
+            // Shortcut (potentially not guaranteed by the algorithm)
+            return 0;
+        }
+        else if ( text.empty() )
+        {
+            // Nothing to match.
+            return -1;
+        }
+        else if ( loc + pattern.fPattern.length() <= text.length() && safeMid( text, loc, pattern.fPattern.length() ) == pattern.fPattern )
+        {
+            // Perfect match at the perfect spot!  (Includes case of nullptr pattern)
+            return loc;
+        }
+        else
         {
-            throw "Pattern too long for this application.";
+            // Do a fuzzy compare.
+            return match_bitap( text, pattern, loc );
         }
+    }
 
-        // Initialise the alphabet.
-        auto &&s = match_alphabet( pattern );
+    std::size_t diff_match_patch::match_bitap( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc )
+    {
+        const auto &patternText = pattern.fPattern;
+        if ( patternText.empty() )
+        {
+            // An empty pattern matches anywhere.
+            return loc;
+        }
 
         // Highest score beyond which we give up.
         double score_threshold = Match_Threshold;
         // Is there a nearby exact match? (speedup)
-        auto best_loc = text.find( pattern, loc );
+        auto best_loc = text.find( patternText, loc );
+        if ( best_loc != std::string::npos )
+        {
+            score_threshold = std::min( match_bitapScore( 0, best_loc, loc, patternText ), score_threshold );
+            // What about in the other direction? (speedup)
+            auto start = std::min( loc + patternText.length(), text.length() );
+            best_loc = text.rfind( patternText, start );
+            if ( best_loc != std::string::npos )
+            {
+                score_threshold = std::min( match_bitapScore( 0, best_loc, loc, patternText ), score_threshold );
+            }
+        }
+
+        return match_bitapCore( text, pattern, loc, score_threshold );
+    }
+
+    std::size_t diff_match_patch::match_bitap( const SIndexedText &text, const SMatchPattern &pattern, std::size_t loc )
+    {
+        const auto &patternText = pattern.fPattern;
+        if ( patternText.empty() )
+        {
+            // An empty pattern matches anywhere.
+            return loc;
+        }
+
+        // Highest score beyond which we give up.
+        double score_threshold = Match_Threshold;
+        // Is there a nearby exact match? (speedup)  The q-gram index jumps
+        // straight to candidate positions instead of scanning the document.
+        auto best_loc = text.find( patternText, loc );
         if ( best_loc != std::string::npos )
         {
-            score_threshold = std::min( match_bitapScore( 0, best_loc, loc, pattern ), score_threshold );
+            score_threshold = std::min( match_bitapScore( 0, best_loc, loc, patternText ), score_threshold );
             // What about in the other direction? (speedup)
-            auto start = std::min( loc + pattern.length(), text.length() );
-            best_loc = text.rfind( pattern, start );
+            auto start = std::min( loc + patternText.length(), text.text().length() );
+            best_loc = text.rfind( patternText, start );
             if ( best_loc != std::string::npos )
             {
-                score_threshold = std::min( match_bitapScore( 0, best_loc, loc, pattern ), score_threshold );
+                score_threshold = std::min( match_bitapScore( 0, best_loc, loc, patternText ), score_threshold );
             }
         }
+        return match_bitapCore( text.text(), pattern, loc, score_threshold );
+    }
+
+    std::size_t diff_match_patch::match_bitapCore( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc, double score_threshold )
+    {
+        // Blocked bitap over the precompiled alphabet: every bitmask is an
+        // array of 64-bit words, so the pattern length is unbounded.  The rd
+        // arrays are stored flat, one 'words'-wide row per text position.
+        const auto &patternText = pattern.fPattern;
+        const std::size_t words = pattern.fWords;
 
-        // Initialise the bit arrays.
-        auto matchmask = 1 << ( pattern.length() - 1 );
-        best_loc = std::string::npos;
+        // The word and bit holding the match flag for the final pattern char.
+        const auto matchWord = ( patternText.length() - 1 ) / 64;
+        const uint64_t matchmask = 1ULL << ( ( patternText.length() - 1 ) % 64 );
+        auto best_loc = std::string::npos;
 
         std::size_t bin_min, bin_mid;
-        auto bin_max = pattern.length() + text.length();
-        std::vector< int64_t > rd;
-        std::vector< int64_t > last_rd;
-        for ( int d = 0; d < pattern.length(); d++ )
+        auto bin_max = patternText.length() + text.length();
+        std::vector< uint64_t > rd;
+        std::vector< uint64_t > last_rd;
+        for ( std::size_t d = 0; d < patternText.length(); d++ )
         {
             // Scan for the best match; each iteration allows for one more error.
             // Run a binary search to determine how far from 'loc' we can stray at
@@ -1669,7 +2474,7 @@ namespace NDiffMatchPatch
             bin_mid = bin_max;
             while ( bin_min < bin_mid )
             {
-                if ( match_bitapScore( d, loc + bin_mid, loc, pattern ) <= score_threshold )
+                if ( match_bitapScore( d, loc + bin_mid, loc, patternText ) <= score_threshold )
                 {
                     bin_min = bin_mid;
                 }
@@ -1682,39 +2487,44 @@ namespace NDiffMatchPatch
             // Use the result from this iteration as the maximum for the next.
             bin_max = bin_mid;
             auto start = std::max( kONE, ( loc > bin_mid ) ? ( loc - bin_mid + 1 ) : kZERO );
-            auto finish = std::min( loc + bin_mid, text.length() ) + pattern.length();
+            auto finish = std::min( loc + bin_mid, text.length() ) + patternText.length();
 
-            rd = std::vector< int64_t >( finish + 2, 0 );
-            rd[ finish + 1 ] = ( 1 << d ) - 1;
+            rd = std::vector< uint64_t >( ( finish + 2 ) * words, 0 );
+            // Seed the row past the end with the d low bits set.
+            for ( std::size_t bit = 0; bit < d; bit++ )
+            {
+                rd[ ( finish + 1 ) * words + bit / 64 ] |= 1ULL << ( bit % 64 );
+            }
             for ( auto j = finish; ( j != -1 ) && ( j >= start ); j-- )
             {
-                int64_t charMatch;
-                if ( text.length() <= j - 1 )
-                {
-                    // Out of range.
-                    charMatch = 0;
-                }
-                else
+                const auto charMatch = ( text.length() > j - 1 ) ? pattern.mask( text[ j - 1 ] ) : pattern.fZero.data();
+                auto row = &rd[ j * words ];
+                const auto up = &rd[ ( j + 1 ) * words ];
+                // (rd[j+1] << 1 | 1) & charMatch, with the carry rippling
+                // through the words.
+                uint64_t carry = 1;
+                for ( std::size_t w = 0; w < words; w++ )
                 {
-                    auto pos = s.find( text[ j - 1 ] );
-                    if ( pos == s.end() )
-                        charMatch = 0;
-                    else
-                        charMatch = ( *pos ).second;
-                }
-                if ( d == 0 )
-                {
-                    // First pass: exact match.
-                    rd[ j ] = ( ( rd[ j + 1 ] << 1 ) | 1 ) & charMatch;
+                    row[ w ] = ( ( up[ w ] << 1 ) | carry ) & charMatch[ w ];
+                    carry = up[ w ] >> 63;
                 }
-                else
+                if ( d != 0 )
                 {
                     // Subsequent passes: fuzzy match.
-                    rd[ j ] = ( ( rd[ j + 1 ] << 1 ) | 1 ) & charMatch | ( ( ( last_rd[ j + 1 ] | last_rd[ j ] ) << 1 ) | 1 ) | last_rd[ j + 1 ];
+                    // | ((last_rd[j+1] | last_rd[j]) << 1 | 1) | last_rd[j+1]
+                    const auto lastUp = &last_rd[ ( j + 1 ) * words ];
+                    const auto lastRow = &last_rd[ j * words ];
+                    carry = 1;
+                    for ( std::size_t w = 0; w < words; w++ )
+                    {
+                        auto both = lastUp[ w ] | lastRow[ w ];
+                        row[ w ] |= ( ( both << 1 ) | carry ) | lastUp[ w ];
+                        carry = both >> 63;
+                    }
                 }
-                if ( ( rd[ j ] & matchmask ) != 0 )
+                if ( ( row[ matchWord ] & matchmask ) != 0 )
                 {
-                    double score = match_bitapScore( d, j - 1, loc, pattern );
+                    double score = match_bitapScore( d, j - 1, loc, patternText );
                     // This match will almost certainly be better than any existing
                     // match.  But check anyway.
                     if ( score <= score_threshold )
@@ -1735,7 +2545,7 @@ namespace NDiffMatchPatch
                     }
                 }
             }
-            if ( match_bitapScore( d + 1, loc, loc, pattern ) > score_threshold )
+            if ( match_bitapScore( d + 1, loc, loc, patternText ) > score_threshold )
             {
                 // No hope for a (better) match at greater error levels.
                 break;
@@ -1745,66 +2555,202 @@ namespace NDiffMatchPatch
         return best_loc;
     }
 
-    std::size_t diff_match_patch::match_bitap( const std::string &text, const std::string &pattern, std::size_t loc )
+    diff_match_patch::SMatchPattern::SMatchPattern( const std::wstring &pattern ) :
+        fPattern( pattern )
     {
-        return match_bitap( NUtils::to_wstring( text ), NUtils::to_wstring( pattern ), loc );
+        compile();
     }
 
-    double diff_match_patch::match_bitapScore( int64_t e, int64_t x, int64_t loc, const std::wstring &pattern )
+    diff_match_patch::SMatchPattern::SMatchPattern( const std::string &pattern ) :
+        fPattern( NUtils::to_wstring( pattern ) )
     {
-        const float accuracy = static_cast< float >( e ) / pattern.length();
-        const auto proximity = std::abs( loc - x );
-        if ( Match_Distance == 0 )
+        compile();
+    }
+
+    void diff_match_patch::SMatchPattern::compile()
+    {
+        fWords = std::max( kONE, ( fPattern.length() + 63 ) / 64 );
+        fZero.assign( fWords, 0 );
+
+        // Size the table to the next power of two at least twice the pattern
+        // length, keeping the load factor below one half.
+        std::size_t slots = 4;
+        while ( slots < fPattern.length() * 2 )
         {
-            // Dodge divide by zero error.
-            return proximity == 0 ? accuracy : 1.0;
+            slots <<= 1;
+        }
+        fTableMask = slots - 1;
+        fKeys.assign( slots, 0 );
+        fUsed.assign( slots, 0 );
+        fMasks.assign( slots * fWords, 0 );
+
+        for ( std::size_t i = 0; i < fPattern.length(); i++ )
+        {
+            auto c = fPattern[ i ];
+            auto slot = ( static_cast< uint32_t >( c ) * 2654435761ULL ) & fTableMask;
+            while ( fUsed[ slot ] && ( fKeys[ slot ] != c ) )
+            {
+                slot = ( slot + 1 ) & fTableMask;
+            }
+            fUsed[ slot ] = 1;
+            fKeys[ slot ] = c;
+            auto bit = fPattern.length() - i - 1;
+            fMasks[ slot * fWords + bit / 64 ] |= 1ULL << ( bit % 64 );
         }
-        return accuracy + ( proximity / static_cast< float >( Match_Distance ) );
     }
 
-    diff_match_patch::TCharPosMap diff_match_patch::match_alphabet( const std::wstring &pattern )
+    const uint64_t *diff_match_patch::SMatchPattern::mask( wchar_t ch ) const
     {
-        TCharPosMap s;
-        std::size_t i;
-        for ( i = 0; i < pattern.length(); i++ )
+        auto slot = ( static_cast< uint32_t >( ch ) * 2654435761ULL ) & fTableMask;
+        while ( fUsed[ slot ] )
+        {
+            if ( fKeys[ slot ] == ch )
+            {
+                return &fMasks[ slot * fWords ];
+            }
+            slot = ( slot + 1 ) & fTableMask;
+        }
+        return fZero.data();
+    }
+
+    std::size_t diff_match_patch::match_main( const SIndexedText &text, const SMatchPattern &pattern, std::size_t loc )
+    {
+        loc = std::max( kZERO, std::min( loc, text.text().length() ) );
+        if ( text.text() == pattern.fPattern )
+        {
+            // Shortcut (potentially not guaranteed by the algorithm)
+            return 0;
+        }
+        else if ( text.text().empty() )
+        {
+            // Nothing to match.
+            return -1;
+        }
+        else if ( loc + pattern.fPattern.length() <= text.text().length() && safeMid( text.text(), loc, pattern.fPattern.length() ) == pattern.fPattern )
+        {
+            // Perfect match at the perfect spot!  (Includes case of nullptr pattern)
+            return loc;
+        }
+        else
+        {
+            // Do a fuzzy compare.
+            return match_bitap( text, pattern, loc );
+        }
+    }
+
+    diff_match_patch::SIndexedText::SIndexedText( std::wstring text ) :
+        fText( std::move( text ) )
+    {
+        if ( fText.length() < kGramLength )
+        {
+            return;
+        }
+        fGrams.reserve( fText.length() - kGramLength + 1 );
+        for ( std::size_t pos = 0; pos + kGramLength <= fText.length(); pos++ )
+        {
+            fGrams.emplace_back( gram( fText.data() + pos ), static_cast< uint32_t >( pos ) );
+        }
+        std::sort( fGrams.begin(), fGrams.end() );
+    }
+
+    uint64_t diff_match_patch::SIndexedText::gram( const wchar_t *chars )
+    {
+        // FNV-1a over the window; collisions are harmless because every
+        // candidate position is verified against the actual text.
+        uint64_t hash = 14695981039346656037ULL;
+        for ( std::size_t i = 0; i < kGramLength; i++ )
+        {
+            hash = ( hash ^ static_cast< uint32_t >( chars[ i ] ) ) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::size_t diff_match_patch::SIndexedText::find( std::wstring_view pattern, std::size_t from ) const
+    {
+        if ( pattern.length() < kGramLength )
         {
-            auto c = pattern[ i ];
-            s[ c ] = 0;
+            // Too short for a full q-gram; the linear scan is cheap here.
+            return fText.find( pattern, from );
         }
-        for ( i = 0; i < pattern.length(); i++ )
+        auto key = gram( pattern.data() );
+        auto clamped = static_cast< uint32_t >( std::min< std::size_t >( from, std::numeric_limits< uint32_t >::max() ) );
+        auto lo = std::lower_bound( fGrams.begin(), fGrams.end(), std::make_pair( key, clamped ) );
+        auto hi = std::upper_bound( lo, fGrams.end(), std::make_pair( key, std::numeric_limits< uint32_t >::max() ) );
+        for ( auto it = lo; it != hi; ++it )
         {
-            auto c = pattern[ i ];
-            auto pos = s.find( c );
-            std::size_t prev = 0;
-            if ( pos != s.end() )
-                prev = ( *pos ).second;
-            s[ c ] = prev | ( 1ULL << ( pattern.length() - i - 1 ) );
+            if ( fText.compare( ( *it ).second, pattern.length(), pattern ) == 0 )
+            {
+                return ( *it ).second;
+            }
         }
-        return s;
+        return std::wstring::npos;
     }
 
-    diff_match_patch::TCharPosMap diff_match_patch::match_alphabet( const std::string &pattern )
+    std::size_t diff_match_patch::SIndexedText::rfind( std::wstring_view pattern, std::size_t from ) const
     {
-        return match_alphabet( NUtils::to_wstring( pattern ) );
+        if ( pattern.length() < kGramLength )
+        {
+            return fText.rfind( pattern, from );
+        }
+        auto key = gram( pattern.data() );
+        auto lo = std::lower_bound( fGrams.begin(), fGrams.end(), std::make_pair( key, static_cast< uint32_t >( 0 ) ) );
+        auto clamped = static_cast< uint32_t >( std::min< std::size_t >( from, std::numeric_limits< uint32_t >::max() ) );
+        auto hi = std::upper_bound( lo, fGrams.end(), std::make_pair( key, clamped ) );
+        while ( hi != lo )
+        {
+            --hi;
+            if ( fText.compare( ( *hi ).second, pattern.length(), pattern ) == 0 )
+            {
+                return ( *hi ).second;
+            }
+        }
+        return std::wstring::npos;
     }
 
     //  PATCH FUNCTIONS
 
     void diff_match_patch::patch_addContext( Patch &patch, const std::wstring &text )
+    {
+        std::unique_ptr< SIndexedText > index;
+        patch_addContext( patch, text, index );
+    }
+
+    void diff_match_patch::patch_addContext( Patch &patch, const std::wstring &text, std::unique_ptr< SIndexedText > &index )
     {
         if ( text.empty() )
         {
             return;
         }
-        std::wstring pattern = safeMid( text, patch.start2, patch.length1 );
+        const auto whole = std::wstring_view( text );
+        auto patternStart = patch.start2;
+        auto pattern = whole.substr( patch.start2, patch.length1 );
         std::size_t padding = 0;
 
-        // Look for the first and last matches of pattern in text.  If two different
-        // matches are found, increase the pattern length.
-        while ( ( text.find( pattern ) != text.rfind( pattern ) ) && ( pattern.length() < ( Match_MaxBits - Patch_Margin - Patch_Margin ) ) )
+        // The pattern is a view into 'text' known to occur at patternStart,
+        // so it is unique exactly when no other occurrence exists.
+        auto isUnique = [ & ]()
+        {
+            if ( index )
+            {
+                return ( index->find( pattern ) == patternStart ) && ( index->rfind( pattern ) == patternStart );
+            }
+            return ( whole.find( pattern ) == patternStart ) && ( whole.find( pattern, patternStart + 1 ) == std::wstring_view::npos );
+        };
+
+        // If two different matches are found, increase the pattern length.
+        // The first probe scans the text directly; once the context has to
+        // grow, further probes run against a q-gram index that is built at
+        // most once per source text and shared by every patch drawn from it.
+        while ( !isUnique() && ( ( Match_MaxBits == 0 ) || ( pattern.length() < ( Match_MaxBits - Patch_Margin - Patch_Margin ) ) ) )
         {
+            if ( !index && ( text.length() >= kContextIndexThreshold ) )
+            {
+                index = std::make_unique< SIndexedText >( text );
+            }
             padding += Patch_Margin;
-            pattern = safeMid( text, std::max( kZERO, ( ( patch.start2 > padding ) ? patch.start2 - padding : 0UL ) ), std::min( text.length(), patch.start2 + patch.length1 + padding ) - std::max( kZERO, ( patch.start2 > padding ) ? patch.start2 - padding : 0 ) );
+            patternStart = ( patch.start2 > padding ) ? patch.start2 - padding : 0;
+            const auto patternEnd = std::min( text.length(), patch.start2 + patch.length1 + padding );
+            pattern = whole.substr( patternStart, patternEnd - patternStart );
         }
         // Add one chunk for good luck.
         padding += Patch_Margin;
@@ -1882,6 +2828,9 @@ namespace NDiffMatchPatch
         // context info.
         std::wstring prepatch_text = text1;
         std::wstring postpatch_text = text1;
+        // One uniqueness index serves every patch drawn from the same
+        // prepatch text; it is invalidated when the rolling context moves on.
+        std::unique_ptr< SIndexedText > contextIndex;
         for ( auto &&aDiff : diffs )
         {
             if ( patch.diffs.empty() && !aDiff.isEqual() )
@@ -1918,7 +2867,7 @@ namespace NDiffMatchPatch
                     // Time for a new patch.
                     if ( !patch.diffs.empty() )
                     {
-                        patch_addContext( patch, prepatch_text );
+                        patch_addContext( patch, prepatch_text, contextIndex );
                         patches.emplace_back( patch );
                         patch = Patch();
                         // Unlike Unidiff, our patch lists have a rolling context.
@@ -1926,6 +2875,7 @@ namespace NDiffMatchPatch
                         // Update prepatch text & pos to reflect the application of the
                         // just completed patch.
                         prepatch_text = postpatch_text;
+                        contextIndex.reset();
                         char_count1 = char_count2;
                     }
                 }
@@ -1944,7 +2894,7 @@ namespace NDiffMatchPatch
         // Pick up the leftover patch if not empty.
         if ( !patch.diffs.empty() )
         {
-            patch_addContext( patch, prepatch_text );
+            patch_addContext( patch, prepatch_text, contextIndex );
             patches.emplace_back( patch );
         }
 
@@ -2012,7 +2962,7 @@ namespace NDiffMatchPatch
             std::wstring text1 = diff_text1( aPatch.diffs );
             std::size_t start_loc;
             std::size_t end_loc = std::string::npos;
-            if ( text1.length() > Match_MaxBits )
+            if ( ( Match_MaxBits != 0 ) && ( text1.length() > Match_MaxBits ) )
             {
                 // patch_splitMax will only provide an oversized pattern in the case of
                 // a monster delete.
@@ -2062,7 +3012,7 @@ namespace NDiffMatchPatch
                     // Imperfect match.  Run a diff to get a framework of equivalent
                     // indices.
                     TDiffVector diffs = diff_main( text1, text2, false );
-                    if ( text1.length() > Match_MaxBits && diff_levenshtein( diffs ) / static_cast< float >( text1.length() ) > Patch_DeleteThreshold )
+                    if ( ( Match_MaxBits != 0 ) && ( text1.length() > Match_MaxBits ) && ( diff_levenshtein( diffs ) / static_cast< float >( text1.length() ) > Patch_DeleteThreshold ) )
                     {
                         // The end points match, but the content is unacceptably bad.
                         results[ x ] = false;
@@ -2107,6 +3057,168 @@ namespace NDiffMatchPatch
         return patch_apply( patches, NUtils::to_wstring( text ) );
     }
 
+    std::pair< std::wstring, std::vector< bool > > diff_match_patch::patch_apply( TPatchVector patches, std::wstring text, const SOptions &options ) const
+    {
+        diff_match_patch engine( options );
+        return engine.patch_apply( std::move( patches ), std::move( text ) );
+    }
+
+    std::pair< std::wstring, std::vector< bool > > diff_match_patch::patch_applyBuffered( TPatchVector patches, const std::wstring &text )
+    {
+        if ( patches.empty() )
+        {
+            return { text, std::vector< bool >( 0 ) };
+        }
+
+        // Deep copy the patches so that no changes are made to originals.
+        patches = patch_deepCopy( patches );
+
+        std::wstring nullPadding = patch_addPadding( patches );
+        // The original stays immutable, so the q-gram index built here stays
+        // valid for every hunk.
+        SIndexedText padded( nullPadding + text + nullPadding );
+        patch_splitMax( patches );
+
+        // A pending splice of the original document: remove fLength
+        // characters at fStart and insert fText in their place.
+        struct SSplice
+        {
+            std::size_t fStart{ 0 };
+            std::size_t fLength{ 0 };
+            std::wstring fText;
+        };
+        std::vector< SSplice > splices;
+
+        std::size_t x = 0;
+        // delta tracks the drift between where patches were expected in the
+        // original document and where they were actually found.
+        uint64_t delta = 0;
+        std::vector< bool > results( patches.size() );
+        for ( auto &&aPatch : patches )
+        {
+            auto expected_loc = aPatch.start1 + delta;
+            std::wstring text1 = diff_text1( aPatch.diffs );
+            std::size_t start_loc;
+            std::size_t end_loc = std::string::npos;
+            if ( ( Match_MaxBits != 0 ) && ( text1.length() > Match_MaxBits ) )
+            {
+                // patch_splitMax will only provide an oversized pattern in the case of
+                // a monster delete.
+                start_loc = match_main( padded, SMatchPattern( text1.substr( 0, Match_MaxBits ) ), expected_loc );
+                if ( start_loc != -1 )
+                {
+                    end_loc = match_main( padded, SMatchPattern( text1.substr( text1.length() - Match_MaxBits ) ), expected_loc + text1.length() - Match_MaxBits );
+                    if ( end_loc == -1 || start_loc >= end_loc )
+                    {
+                        // Can't find valid trailing context.  Drop this patch.
+                        start_loc = -1;
+                    }
+                }
+            }
+            else
+            {
+                start_loc = match_main( padded, SMatchPattern( text1 ), expected_loc );
+            }
+            if ( start_loc == -1 )
+            {
+                // No match found.  :(
+                results[ x ] = false;
+            }
+            else
+            {
+                // Found a match.  :)
+                results[ x ] = true;
+                delta = start_loc - aPatch.start1;
+                std::wstring text2;
+                if ( end_loc == -1 )
+                {
+                    text2 = safeMid( padded.text(), start_loc, text1.length() );
+                }
+                else
+                {
+                    text2 = safeMid( padded.text(), start_loc, end_loc + Match_MaxBits - start_loc );
+                }
+                if ( text1 == text2 )
+                {
+                    // Perfect match: one splice replaces the whole window.
+                    splices.push_back( SSplice{ start_loc, text1.length(), diff_text2( aPatch.diffs ) } );
+                }
+                else
+                {
+                    // Imperfect match.  Run a diff to get a framework of equivalent
+                    // indices.
+                    TDiffVector diffs = diff_main( text1, text2, false );
+                    if ( ( Match_MaxBits != 0 ) && ( text1.length() > Match_MaxBits ) && ( diff_levenshtein( diffs ) / static_cast< float >( text1.length() ) > Patch_DeleteThreshold ) )
+                    {
+                        // The end points match, but the content is unacceptably bad.
+                        results[ x ] = false;
+                    }
+                    else
+                    {
+                        diff_cleanupSemanticLossless( diffs );
+                        std::size_t index1 = 0;
+                        for ( auto &&aDiff : aPatch.diffs )
+                        {
+                            if ( !aDiff.isEqual() )
+                            {
+                                auto index2 = diff_xIndex( diffs, index1 );
+                                if ( aDiff.isInsert() )
+                                {
+                                    // Insertion
+                                    splices.push_back( SSplice{ start_loc + index2, 0, aDiff.text() } );
+                                }
+                                else if ( aDiff.isDelete() )
+                                {
+                                    // Deletion
+                                    auto deleteEnd = diff_xIndex( diffs, index1 + aDiff.text().length() );
+                                    splices.push_back( SSplice{ start_loc + index2, deleteEnd - index2, std::wstring() } );
+                                }
+                            }
+                            if ( !aDiff.isDelete() )
+                            {
+                                index1 += aDiff.text().length();
+                            }
+                        }
+                    }
+                }
+            }
+            x++;
+        }
+
+        // Materialize the output in a single pass over the original.
+        std::stable_sort( splices.begin(), splices.end(), []( const SSplice &lhs, const SSplice &rhs ) { return lhs.fStart < rhs.fStart; } );
+        const auto &original = padded.text();
+        int64_t growth = 0;
+        for ( auto &&splice : splices )
+        {
+            growth += static_cast< int64_t >( splice.fText.length() ) - static_cast< int64_t >( splice.fLength );
+        }
+        std::wstring output;
+        output.reserve( original.length() + static_cast< std::size_t >( std::max< int64_t >( growth, 0 ) ) );
+        std::size_t cursor = 0;
+        for ( auto &&splice : splices )
+        {
+            // Hunks that landed on overlapping regions are clamped to keep
+            // the pass monotonic.
+            auto spliceStart = std::max( splice.fStart, cursor );
+            auto spliceEnd = std::min( splice.fStart + splice.fLength, original.length() );
+            if ( spliceStart > cursor )
+            {
+                output.append( original, cursor, spliceStart - cursor );
+            }
+            output += splice.fText;
+            cursor = std::max( cursor, spliceEnd );
+        }
+        if ( cursor < original.length() )
+        {
+            output.append( original, cursor, original.length() - cursor );
+        }
+
+        // Strip the padding off.
+        output = safeMid( output, nullPadding.length(), output.length() - 2 * nullPadding.length() );
+        return { output, results };
+    }
+
     std::wstring diff_match_patch::patch_addPadding( TPatchVector &patches )
     {
         auto paddingLength = Patch_Margin;
@@ -2172,6 +3284,11 @@ namespace NDiffMatchPatch
 
     void diff_match_patch::patch_splitMax( TPatchVector &patches )
     {
+        if ( Match_MaxBits == 0 )
+        {
+            // No splitting limit.
+            return;
+        }
         auto patch_size = Match_MaxBits;
         for ( int x = 0; x < patches.size(); x++ )
         {
@@ -2290,6 +3407,16 @@ namespace NDiffMatchPatch
         return text;
     }
 
+    void diff_match_patch::patch_toText( const TPatchVector &patches, std::wostream &out )
+    {
+        // Write header and hunk lines as they are produced rather than
+        // concatenating the whole report first.
+        for ( auto &&aPatch : patches )
+        {
+            aPatch.toString( out );
+        }
+    }
+
     TPatchVector diff_match_patch::patch_fromText( const std::wstring &textline )
     {
         TPatchVector patches;
@@ -2356,6 +3483,136 @@ namespace NDiffMatchPatch
         return patch_fromText( NUtils::to_wstring( textline ) );
     }
 
+    namespace
+    {
+        // Binary patch format, version 1: "DMP" + version byte, then varint
+        // patch count; per patch the varint coordinates start1, length1,
+        // start2, length2 and diff count; per diff one operation byte and the
+        // length-prefixed raw UTF-8 hunk text.
+        constexpr char kBinaryMagic[] = { 'D', 'M', 'P' };
+        constexpr char kBinaryVersion = 1;
+
+        void appendVarint( std::string &out, uint64_t value )
+        {
+            while ( value >= 0x80 )
+            {
+                out += static_cast< char >( ( value & 0x7f ) | 0x80 );
+                value >>= 7;
+            }
+            out += static_cast< char >( value );
+        }
+
+        uint64_t readVarint( std::string_view data, std::size_t &pos )
+        {
+            uint64_t value = 0;
+            int shift = 0;
+            while ( pos < data.size() )
+            {
+                auto byte = static_cast< unsigned char >( data[ pos++ ] );
+                if ( shift >= 64 )
+                {
+                    throw std::wstring( L"Varint overflow in binary patch." );
+                }
+                value |= static_cast< uint64_t >( byte & 0x7f ) << shift;
+                if ( ( byte & 0x80 ) == 0 )
+                {
+                    return value;
+                }
+                shift += 7;
+            }
+            throw std::wstring( L"Truncated varint in binary patch." );
+        }
+    }
+
+    std::string diff_match_patch::patch_toBinary( const TPatchVector &patches )
+    {
+        std::string out;
+        out.append( kBinaryMagic, sizeof( kBinaryMagic ) );
+        out += kBinaryVersion;
+        appendVarint( out, patches.size() );
+        for ( auto &&aPatch : patches )
+        {
+            appendVarint( out, aPatch.start1 );
+            appendVarint( out, aPatch.length1 );
+            appendVarint( out, aPatch.start2 );
+            appendVarint( out, aPatch.length2 );
+            appendVarint( out, aPatch.diffs.size() );
+            for ( auto &&aDiff : aPatch.diffs )
+            {
+                out += static_cast< char >( aDiff.fOperation );
+                auto bytes = NUtils::toUtf8( aDiff.fText );
+                appendVarint( out, bytes.size() );
+                out += bytes;
+            }
+        }
+        return out;
+    }
+
+    TPatchVector diff_match_patch::patch_fromBinary( std::string_view data )
+    {
+        if ( ( data.size() < sizeof( kBinaryMagic ) + 1 ) || ( data.compare( 0, sizeof( kBinaryMagic ), kBinaryMagic, sizeof( kBinaryMagic ) ) != 0 ) )
+        {
+            throw std::wstring( L"Invalid binary patch header." );
+        }
+        if ( data[ sizeof( kBinaryMagic ) ] != kBinaryVersion )
+        {
+            throw std::wstring( L"Unsupported binary patch version." );
+        }
+
+        std::size_t pos = sizeof( kBinaryMagic ) + 1;
+        auto patchCount = readVarint( data, pos );
+        // The counts come straight from the wire; sanity-check them against
+        // the bytes actually present before reserving, or a ~20 byte blob
+        // could demand an exabyte allocation.  Every patch record is at
+        // least five varint bytes, every diff record at least two.
+        if ( patchCount > ( data.size() - pos ) / 5 )
+        {
+            throw std::wstring( L"Truncated binary patch." );
+        }
+        TPatchVector patches;
+        patches.reserve( patchCount );
+        for ( uint64_t ii = 0; ii < patchCount; ii++ )
+        {
+            patches.emplace_back();
+            auto &patch = patches.back();
+            patch.start1 = readVarint( data, pos );
+            patch.length1 = readVarint( data, pos );
+            patch.start2 = readVarint( data, pos );
+            patch.length2 = readVarint( data, pos );
+            auto diffCount = readVarint( data, pos );
+            if ( diffCount > ( data.size() - pos ) / 2 )
+            {
+                throw std::wstring( L"Truncated binary patch." );
+            }
+            patch.diffs.reserve( diffCount );
+            for ( uint64_t jj = 0; jj < diffCount; jj++ )
+            {
+                if ( pos >= data.size() )
+                {
+                    throw std::wstring( L"Truncated binary patch." );
+                }
+                auto op = static_cast< unsigned char >( data[ pos++ ] );
+                if ( op > static_cast< unsigned char >( EOperation::eEQUAL ) )
+                {
+                    throw std::wstring( L"Invalid operation in binary patch." );
+                }
+                auto length = readVarint( data, pos );
+                if ( length > data.size() - pos )
+                {
+                    throw std::wstring( L"Truncated hunk text in binary patch." );
+                }
+                // Decode straight out of the input buffer.
+                patch.diffs.emplace_back( static_cast< EOperation >( op ), NUtils::fromUtf8( data.substr( pos, length ) ) );
+                pos += length;
+            }
+        }
+        if ( pos != data.size() )
+        {
+            throw std::wstring( L"Trailing bytes in binary patch." );
+        }
+        return patches;
+    }
+
     std::wstring diff_match_patch::safeMid( const std::wstring &str, std::size_t pos )
     {
         return safeMid( str, pos, std::string::npos );
@@ -2393,4 +3650,118 @@ namespace NDiffMatchPatch
             return LR"("")";
         return retVal;
     }
+
+    /////////////////////////////////////////////
+    //
+    // incremental_diff_session Class
+    //
+    /////////////////////////////////////////////
+
+    incremental_diff_session::incremental_diff_session( std::wstring initialText ) :
+        fText( std::move( initialText ) )
+    {
+    }
+
+    void incremental_diff_session::reset( std::wstring text )
+    {
+        fText = std::move( text );
+    }
+
+    TDiffVector incremental_diff_session::advance( std::wstring newText )
+    {
+        using TCore = basic_diff_match_patch< wchar_t >;
+        auto view1 = std::wstring_view( fText );
+        auto view2 = std::wstring_view( newText );
+
+        // Trim the untouched affixes with block compares; everything between
+        // them is the dirty window.
+        auto prefix = TCore::diff_commonPrefix( view1, view2 );
+        auto suffix = TCore::diff_commonSuffix( view1.substr( prefix ), view2.substr( prefix ) );
+
+        auto middle1 = std::wstring( view1.substr( prefix, view1.length() - prefix - suffix ) );
+        auto middle2 = std::wstring( view2.substr( prefix, view2.length() - prefix - suffix ) );
+
+        // The engine only ever sees the dirty window; the context (and its
+        // bisect workspace) carries over from earlier calls.
+        TDiffVector diffs;
+        if ( !middle1.empty() || !middle2.empty() )
+        {
+            SDeadline deadline( dmp.Diff_Timeout, dmp.Diff_Cancel );
+            diffs = dmp.diff_main( middle1, middle2, true, deadline, fContext );
+        }
+
+        // Restore the affixes and merge any equality the window diff left at
+        // its edges.
+        if ( prefix != 0 )
+        {
+            diffs.emplace( diffs.begin(), EOperation::eEQUAL, std::wstring( view1.substr( 0, prefix ) ) );
+        }
+        if ( suffix != 0 )
+        {
+            diffs.emplace_back( EOperation::eEQUAL, std::wstring( view1.substr( view1.length() - suffix ) ) );
+        }
+        dmp.diff_cleanupMerge( diffs );
+
+        fText = std::move( newText );
+        return diffs;
+    }
+
+    diff_position_map::diff_position_map( const TDiffVector &diffs )
+    {
+        fChars1.reserve( diffs.size() );
+        fChars2.reserve( diffs.size() );
+        fOps.reserve( diffs.size() );
+        std::size_t chars1 = 0;
+        std::size_t chars2 = 0;
+        for ( auto &&aDiff : diffs )
+        {
+            if ( !aDiff.isInsert() )
+            {
+                chars1 += aDiff.text().length();
+            }
+            if ( !aDiff.isDelete() )
+            {
+                chars2 += aDiff.text().length();
+            }
+            fChars1.push_back( chars1 );
+            fChars2.push_back( chars2 );
+            fOps.push_back( aDiff.fOperation );
+        }
+    }
+
+    std::size_t diff_position_map::toText2( std::size_t loc ) const
+    {
+        // A text1 offset falling inside a deletion maps to the cut point.
+        return translate( fChars1, fChars2, EOperation::eDELETE, loc );
+    }
+
+    std::size_t diff_position_map::toText1( std::size_t loc ) const
+    {
+        // A text2 offset falling inside an insertion maps to the insertion
+        // point; the roles of the two prefix sums simply swap.
+        return translate( fChars2, fChars1, EOperation::eINSERT, loc );
+    }
+
+    std::size_t diff_position_map::translate( const std::vector< std::size_t > &from, const std::vector< std::size_t > &to, EOperation removedBy, std::size_t loc ) const
+    {
+        // First hunk whose cumulative source length overshoots the location;
+        // mirrors the walk in diff_xIndex, with the prefix sums standing in
+        // for the running chars1/chars2 counters.
+        auto overshot = std::upper_bound( from.begin(), from.end(), loc );
+        if ( overshot == from.end() )
+        {
+            const auto last_from = from.empty() ? 0 : from.back();
+            const auto last_to = to.empty() ? 0 : to.back();
+            return last_to + ( loc - last_from );
+        }
+        const auto index = static_cast< std::size_t >( overshot - from.begin() );
+        const auto last_from = ( index == 0 ) ? 0 : from[ index - 1 ];
+        const auto last_to = ( index == 0 ) ? 0 : to[ index - 1 ];
+        if ( fOps[ index ] == removedBy )
+        {
+            // The location does not exist in the target text.
+            return last_to;
+        }
+        return last_to + ( loc - last_from );
+    }
 }
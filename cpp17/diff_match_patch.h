@@ -20,12 +20,19 @@
 #ifndef DIFF_MATCH_PATCH_H
 #define DIFF_MATCH_PATCH_H
 
+#include "diff_match_patch_core.h"
 #include "diff_match_patch_utils.h"
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <iosfwd>
 #include <map>
+#include <memory>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -91,6 +98,20 @@ namespace NDiffMatchPatch
         eUnitTest,
         ePatch
     };
+
+    /**
+ * Granularity of the coarse pre-pass run before the character-level diff.
+ * eCHARACTER skips the pre-pass entirely; the other values tokenize the
+ * inputs at the named boundary, diff the token streams, then re-diff the
+ * changed regions character by character.
+ */
+    enum class EDiffGranularity
+    {
+        eCHARACTER,
+        eWORD,
+        eSENTENCE,
+        eLINE
+    };
     /**
  * Class representing one diff operation.
  */
@@ -123,7 +144,11 @@ namespace NDiffMatchPatch
         inline bool isNull() const;
         std::wstring toString( EStringType stringType ) const;
         std::wstring toHtml() const;
+        void toHtml( std::wstring &out ) const;
+        void toHtml( std::wostream &out ) const;
         std::wstring toConsole() const;
+        void toConsole( std::wstring &out ) const;
+        void toConsole( std::wostream &out ) const;
         std::wstring toDelta() const;
 
         bool isDelete() const { return fOperation == EOperation::eDELETE; }
@@ -140,6 +165,40 @@ namespace NDiffMatchPatch
     };
     using TDiffVector = std::vector< Diff >;
 
+    /**
+ * Non-owning flavour of Diff.  The text is a view into the caller-retained
+ * input texts, so a full diff result costs O(number of hunks) memory rather
+ * than a second copy of both documents.  The views are only valid for as long
+ * as the caller keeps the two input strings alive and unmodified; call
+ * materialize() to get an owning Diff when the inputs are going away.
+ */
+    class DiffSpan
+    {
+    public:
+        DiffSpan() = default;
+        DiffSpan( EOperation _operation, std::wstring_view _text ) :
+            fOperation( _operation ),
+            fText( _text )
+        {
+        }
+
+        bool isDelete() const { return fOperation == EOperation::eDELETE; }
+        bool isInsert() const { return fOperation == EOperation::eINSERT; }
+        bool isEqual() const { return fOperation == EOperation::eEQUAL; }
+
+        std::wstring_view text() const { return fText; }
+
+        // Deep copy the viewed text into an owning Diff.
+        Diff materialize() const { return Diff( fOperation, std::wstring( fText ) ); }
+
+        bool operator==( const DiffSpan &d ) const { return ( d.fOperation == fOperation ) && ( d.fText == fText ); }
+        bool operator!=( const DiffSpan &d ) const { return !( operator==( d ) ); }
+
+        EOperation fOperation{ EOperation::eDELETE };
+        std::wstring_view fText;
+    };
+    using TDiffSpanVector = std::vector< DiffSpan >;
+
     /**
  * Class representing one patch operation.
  */
@@ -159,6 +218,7 @@ namespace NDiffMatchPatch
         Patch( std::wstring &text );   // modifies text, and removes the text used
         bool isNull() const;
         std::wstring toString() const;
+        void toString( std::wostream &out ) const;
 
     private:
         std::wstring getPatchHeader() const;
@@ -174,6 +234,7 @@ namespace NDiffMatchPatch
     class diff_match_patch
     {
         friend class NDiffMatchPatch::diff_match_patch_test;
+        friend class incremental_diff_session;
 #ifdef USE_GTEST
         FRIEND_TEST( diff_match_patch_test, testDiffCommonOverlap );
         FRIEND_TEST( diff_match_patch_test, testDiffHalfmatch );
@@ -190,6 +251,11 @@ namespace NDiffMatchPatch
 
         // Number of seconds to map a diff before giving up (0 for infinity).
         float Diff_Timeout{ 1.0f };
+        // Optional cancellation token checked alongside the deadline while a
+        // diff is mapped.  Set the flag (from any thread) to make diff_main
+        // bail out early with a best-effort result, exactly as if the
+        // deadline had expired.  The flag must outlive the diff call.
+        const std::atomic< bool > *Diff_Cancel{ nullptr };
         // Cost of an empty edit operation in terms of edit characters.
         short Diff_EditCost{ 4 };
         // At what point is no match declared (0.0 = perfection, 1.0 = very loose).
@@ -206,20 +272,216 @@ namespace NDiffMatchPatch
         // Chunk size for context length.
         short Patch_Margin{ 4 };
 
-        short Match_MaxBits{ 32 };   // unit tests are based on 32 bits
+        // The length at which patch_apply starts splitting patches (0 = no
+        // splitting).  No longer an engine limit: the blocked bitap handles
+        // patterns of any length, so this can be raised (e.g. to 512) to
+        // match typical hunks in a single pass.  Unit tests are based on the
+        // historical default of 32 bits.
+        short Match_MaxBits{ 32 };
 
-    private:
-        // Define some regex patterns for matching boundaries.
-        static std::wregex BLANKLINEEND;
-        static std::wregex BLANKLINESTART;
+        // Number of additional worker threads the diff recursion may fan out
+        // to (0 = fully serial).  When enabled, the two halves of a large
+        // bisect split are diffed concurrently.  The deadline is measured in
+        // wall-clock time, so parallel runs get the full Diff_Timeout budget.
+        int Diff_Threads{ 0 };
+
+        // When set, each diff_main call fills in the counters retrievable
+        // with diff_lastStats().  Collection is cheap but not free, so it is
+        // off by default.
+        bool Diff_CollectStats{ false };
 
     public:
         using TStringVector = std::vector< std::wstring >;
+        using TStringViewVector = std::vector< std::wstring_view >;
+        using TTextPair = std::pair< std::wstring, std::wstring >;
+        using TTextPairVector = std::vector< TTextPair >;
+        using TProgressCallback = std::function< void( float ) >;
+        using TBisectWorkspace = basic_diff_match_patch< wchar_t >::SBisectWorkspace;
+
+        // Visibility counters for one diff_main call, filled in when
+        // Diff_CollectStats is set and retrievable with diff_lastStats().
+        // Workers spawned by a parallel bisect keep private workspaces, so
+        // their iteration counts are not folded in.
+        struct SDiffStats
+        {
+            std::size_t fBisectCalls{ 0 };   // bisect invocations across the recursion
+            std::size_t fBisectIterations{ 0 };   // Myers d-loop steps in total
+            std::size_t fDeadlineAborts{ 0 };   // bisects that fell back to delete+insert on the deadline
+            std::size_t fMaxDepth{ 0 };   // deepest diff_compute recursion
+            std::size_t fHalfMatchHits{ 0 };   // half-match probes that split the problem
+            std::size_t fHalfMatchMisses{ 0 };
+            std::size_t fLineModeRuns{ 0 };   // coarse token pre-passes taken
+            std::size_t fCleanupRemoved{ 0 };   // hunks merged away by the final cleanup
+            float fTotalSeconds{ 0 };   // wall time of the whole diff_main call
+            float fCleanupSeconds{ 0 };   // wall time of the final diff_cleanupMerge
+        };
+
+        // Approximate progress of one diff_main call.  Characters count as
+        // settled once a leaf of the recursion has emitted them as hunks;
+        // the fraction is monotone and the final callback always reports
+        // 1.0.  The callback fires at most once per whole percent and may
+        // run on any worker thread, so it must be thread-safe and cheap.
+        struct SDiffProgress
+        {
+            TProgressCallback fCallback;
+            std::size_t fTotal{ 0 };   // text1 length + text2 length
+            std::atomic< std::size_t > fSettled{ 0 };
+            std::atomic< int > fLastPercent{ -1 };
+
+            void settle( std::size_t chars );
+        };
+
+        // An immutable per-call snapshot of the tuning knobs above.  The
+        // public knob members make a shared instance a data race; the
+        // SOptions overloads of diff_main/match_main/patch_apply are const
+        // and never touch this instance's mutable state, so one (const)
+        // diff_match_patch can serve any number of threads with each call
+        // carrying its own knobs.  Defaults match the member defaults.
+        struct SOptions
+        {
+            float fDiffTimeout{ 1.0f };
+            const std::atomic< bool > *fDiffCancel{ nullptr };
+            short fDiffEditCost{ 4 };
+            float fMatchThreshold{ 0.5f };
+            int64_t fMatchDistance{ 1000 };
+            float fPatchDeleteThreshold{ 0.5f };
+            short fPatchMargin{ 4 };
+            short fMatchMaxBits{ 32 };
+            int fDiffThreads{ 0 };
+            SDiffStats *fStats{ nullptr };   // when non-null, per-call stats land here
+        };
+
+        // Per-call state threaded through the diff recursion: the reusable
+        // bisect workspace plus the shared budget of worker threads that may
+        // still be spawned.  Each spawned worker gets its own context (and
+        // thus its own workspace) but shares the budget counter, which is
+        // owned by the public diff_main frame.
+        struct SDiffContext
+        {
+            SDiffContext() = default;
+            explicit SDiffContext( std::atomic< int > *threadBudget ) :
+                fThreadBudget( threadBudget )
+            {
+            }
+
+            TBisectWorkspace fWorkspace;
+            basic_diff_match_patch< char32_t >::SBisectWorkspace fTokenWorkspace;
+            std::atomic< int > *fThreadBudget{ nullptr };
+            SDiffStats *fStats{ nullptr };   // non-null only when collecting
+            SDiffProgress *fProgress{ nullptr };   // non-null only for async calls
+            std::size_t fDepth{ 0 };   // current diff_compute recursion depth
+        };
+
+        /**
+   * Counters populated by the most recent diff_main call on this instance.
+   * Only meaningful when Diff_CollectStats was set for that call.
+   * @return The stats of the last collected diff.
+   */
+        const SDiffStats &diff_lastStats() const { return fLastStats; }
+
+    private:
+        SDiffStats fLastStats;
+
+    public:
+
+        // Result of the line-interning tokenizer.  fLines holds views into
+        // the texts handed to diff_linesToTokens; the caller must keep those
+        // texts alive for as long as the views are used.
+        struct SLineTokens
+        {
+            std::u32string fTokens1;
+            std::u32string fTokens2;
+            TStringViewVector fLines;
+        };
         using TVariant = std::variant< std::wstring, TStringVector >;
         using TVariantVector = std::vector< TVariant >;
         using TCharPosMap = std::map< wchar_t, std::size_t >;
 
+        // A pattern precompiled for match_main: the bitap alphabet is built
+        // once into a flat open-addressed table (each character owning an
+        // array of ceil( pattern.length() / 64 ) 64-bit mask words), so the
+        // scan loop probes in O(1) and callers searching the same pattern
+        // against many texts pay for compilation only once.
+        struct SMatchPattern
+        {
+            explicit SMatchPattern( const std::wstring &pattern );
+            explicit SMatchPattern( const std::string &pattern );
+
+            /**
+   * Look up the mask words for a character.
+   * @param ch The character scanned.
+   * @return Pointer to fWords mask words; the all-zero mask if the
+   *         character does not occur in the pattern.
+   */
+            const uint64_t *mask( wchar_t ch ) const;
+
+            std::wstring fPattern;
+            std::size_t fWords{ 1 };   // mask words per character
+            std::vector< uint64_t > fZero;   // all-zero mask returned on a miss
+
+        private:
+            void compile();
+
+            std::vector< wchar_t > fKeys;   // open-addressed, power-of-two size
+            std::vector< uint8_t > fUsed;
+            std::vector< uint64_t > fMasks;   // fKeys.size() * fWords words
+            std::size_t fTableMask{ 0 };
+        };
+
+        // A target text indexed once for repeated match_main searches.  A
+        // sorted q-gram table maps every kGramLength-character window of the
+        // text to its positions, so the exact-occurrence seeding of the bitap
+        // scan jumps straight to candidate positions instead of rescanning
+        // the whole document for every pattern.  Positions are stored as
+        // 32-bit values, capping indexed texts at 4G characters.
+        struct SIndexedText
+        {
+            static constexpr std::size_t kGramLength = 4;
+
+            explicit SIndexedText( std::wstring text );
+
+            const std::wstring &text() const { return fText; }
+
+            /**
+   * Find the first exact occurrence of 'pattern' at or after 'from',
+   * mirroring std::wstring::find.
+   * @param pattern The pattern to search for.
+   * @param from The position to search from.
+   * @return Position of the occurrence or npos.
+   */
+            std::size_t find( std::wstring_view pattern, std::size_t from = 0 ) const;
+
+            /**
+   * Find the last exact occurrence of 'pattern' starting at or before
+   * 'from', mirroring std::wstring::rfind.
+   * @param pattern The pattern to search for.
+   * @param from The highest candidate start position.
+   * @return Position of the occurrence or npos.
+   */
+            std::size_t rfind( std::wstring_view pattern, std::size_t from = std::wstring::npos ) const;
+
+        private:
+            static uint64_t gram( const wchar_t *chars );
+
+            std::wstring fText;
+            std::vector< std::pair< uint64_t, uint32_t > > fGrams;   // sorted by (gram, position)
+        };
+
         diff_match_patch();
+        explicit diff_match_patch( const SOptions &options );
+
+        /**
+   * Snapshot this instance's tuning knobs into an SOptions, e.g. to tweak
+   * one knob for a single call against a shared instance.
+   * @return The current knob values.
+   */
+        SOptions options() const;
+
+        /**
+   * Apply every knob from 'options' to this instance.
+   * @param options The knob values to apply.
+   */
+        void setOptions( const SOptions &options );
 
         //  DIFF FUNCTIONS
 
@@ -247,6 +509,98 @@ namespace NDiffMatchPatch
         TDiffVector diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines );
         TDiffVector diff_main( const std::string &text1, const std::string &text2, bool checklines );
 
+        /**
+   * Find the differences between two texts with per-call options, leaving
+   * this instance untouched.  Safe to call concurrently on one shared
+   * (const) instance; stats, when requested, are written to options.fStats
+   * rather than to diff_lastStats().
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param options Knob values for this call only.
+   * @return Linked List of Diff objects.
+   */
+        TDiffVector diff_main( const std::wstring &text1, const std::wstring &text2, const SOptions &options ) const;
+        TDiffVector diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines, const SOptions &options ) const;
+
+        /**
+   * Find the differences between two texts, choosing the granularity of the
+   * coarse pre-pass.  eCHARACTER and eLINE are equivalent to calling
+   * diff_main with checklines false and true respectively; eWORD and
+   * eSENTENCE run the same tokenize/diff/re-diff pipeline at word or
+   * sentence boundaries, which suits prose the way line mode suits code.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param granularity Granularity of the pre-pass.
+   * @return Linked List of Diff objects.
+   */
+        TDiffVector diff_main( const std::wstring &text1, const std::wstring &text2, EDiffGranularity granularity );
+        TDiffVector diff_main( const std::string &text1, const std::string &text2, EDiffGranularity granularity );
+
+        /**
+   * Find the differences between two texts using a word-granularity
+   * pre-pass.  Equivalent to diff_main with EDiffGranularity::eWORD.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @return Linked List of Diff objects.
+   */
+        TDiffVector diff_wordMode( const std::wstring &text1, const std::wstring &text2 );
+        TDiffVector diff_wordMode( const std::string &text1, const std::string &text2 );
+
+        /**
+   * Find the differences between two texts using a sentence-granularity
+   * pre-pass.  Equivalent to diff_main with EDiffGranularity::eSENTENCE.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @return Linked List of Diff objects.
+   */
+        TDiffVector diff_sentenceMode( const std::wstring &text1, const std::wstring &text2 );
+        TDiffVector diff_sentenceMode( const std::string &text1, const std::string &text2 );
+
+        /**
+   * Find the differences between two texts, returning non-owning spans.
+   * Each resulting DiffSpan views directly into text1 (equalities and
+   * deletions) or text2 (insertions), so the result does not duplicate the
+   * input contents.  The caller must keep both inputs alive and unmodified
+   * for as long as the result is used.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param checklines Speedup flag, as for diff_main().
+   * @return Vector of DiffSpan objects viewing into text1/text2.
+   */
+        TDiffSpanVector diff_main_spans( const std::wstring &text1, const std::wstring &text2 );
+        TDiffSpanVector diff_main_spans( const std::wstring &text1, const std::wstring &text2, bool checklines );
+
+        /**
+   * Find the differences for a batch of text pairs, scheduling the pairs
+   * across numThreads workers.  Workers pull pairs from a shared queue, so
+   * a worker that finishes early immediately takes the next unclaimed
+   * pair, and each worker reuses a single bisect workspace across every
+   * pair it runs instead of allocating per call.  Diff_Timeout and
+   * Diff_Cancel apply to each pair individually.
+   * @param pairs Old/new string pairs to be diffed.
+   * @param numThreads Number of workers (0 or 1 = run on the calling thread).
+   * @return One Diff list per input pair, in input order.
+   */
+        std::vector< TDiffVector > diff_batch( const TTextPairVector &pairs, int numThreads );
+        std::vector< TDiffVector > diff_batch( const TTextPairVector &pairs, bool checklines, int numThreads );
+
+        /**
+   * Find the differences between two texts on a worker thread, without
+   * blocking the calling thread.  Runs against a private engine (like the
+   * SOptions overloads), so a shared instance may launch any number of
+   * concurrent calls; cancel one via options.fDiffCancel.  The optional
+   * progress callback receives a monotone fraction in [0, 1], fires at
+   * most once per whole percent, runs on the worker, and must be
+   * thread-safe.  It always fires a final 1.0 before the future is ready.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param options Knob values for this call only.
+   * @param progress Optional progress callback.
+   * @return A future resolving to the Linked List of Diff objects.
+   */
+        std::future< TDiffVector > diff_main_async( std::wstring text1, std::wstring text2, TProgressCallback progress = TProgressCallback() ) const;
+        std::future< TDiffVector > diff_main_async( std::wstring text1, std::wstring text2, const SOptions &options, TProgressCallback progress = TProgressCallback() ) const;
+
         /**
    * Find the differences between two texts.  Simplifies the problem by
    * stripping any common prefix or suffix off the texts before diffing.
@@ -260,8 +614,8 @@ namespace NDiffMatchPatch
    * @return Linked List of Diff objects.
    */
     private:
-        TDiffVector diff_main( const std::wstring &text1, const std::wstring &text2, bool checklines, clock_t deadline );
-        TDiffVector diff_main( const std::string &text1, const std::string &text2, bool checklines, clock_t deadline );
+        TDiffVector diff_main( std::wstring_view text1, std::wstring_view text2, bool checklines, const SDeadline &deadline, SDiffContext &context );
+        TDiffVector diff_main( const std::string &text1, const std::string &text2, bool checklines, const SDeadline &deadline, SDiffContext &context );
 
         /**
    * Find the differences between two texts.  Assumes that the texts do not
@@ -275,8 +629,8 @@ namespace NDiffMatchPatch
    * @return Linked List of Diff objects.
    */
     private:
-        TDiffVector diff_compute( const std::wstring &text1, const std::wstring &text2, bool checklines, clock_t deadline );
-        TDiffVector diff_compute( const std::string &text1, const std::string &text2, bool checklines, clock_t deadline );
+        TDiffVector diff_compute( std::wstring_view text1, std::wstring_view text2, bool checklines, const SDeadline &deadline, SDiffContext &context );
+        TDiffVector diff_compute( const std::string &text1, const std::string &text2, bool checklines, const SDeadline &deadline, SDiffContext &context );
 
         /**
    * Do a quick line-level diff on both strings, then rediff the parts for
@@ -288,8 +642,22 @@ namespace NDiffMatchPatch
    * @return Linked List of Diff objects.
    */
     private:
-        TDiffVector diff_lineMode( std::wstring text1, std::wstring text2, clock_t deadline );
-        TDiffVector diff_lineMode( std::string text1, std::string text2, clock_t deadline );
+        TDiffVector diff_lineMode( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline, SDiffContext &context );
+        TDiffVector diff_lineMode( std::string text1, std::string text2, const SDeadline &deadline, SDiffContext &context );
+
+        /**
+   * Do a quick diff at the given token granularity, then rediff the changed
+   * parts for greater accuracy.  This is the engine behind line, word and
+   * sentence mode.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param granularity Boundary at which to tokenize (eWORD, eSENTENCE or
+   *     eLINE).
+   * @param deadline Time when the diff should be complete by.
+   * @return Linked List of Diff objects.
+   */
+    private:
+        TDiffVector diff_tokenMode( std::wstring_view text1, std::wstring_view text2, EDiffGranularity granularity, const SDeadline &deadline, SDiffContext &context );
 
         /**
    * Find the 'middle snake' of a diff, split the problem in two
@@ -300,8 +668,9 @@ namespace NDiffMatchPatch
    * @return Linked List of Diff objects.
    */
     protected:
-        TDiffVector diff_bisect( const std::wstring &text1, const std::wstring &text2, clock_t deadline );
-        TDiffVector diff_bisect( const std::string &text1, const std::string &text2, clock_t deadline );
+        TDiffVector diff_bisect( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline );
+        TDiffVector diff_bisect( const std::string &text1, const std::string &text2, const SDeadline &deadline );
+        TDiffVector diff_bisect( std::wstring_view text1, std::wstring_view text2, const SDeadline &deadline, SDiffContext &context );
 
         /**
    * Given the location of the 'middle snake', split the diff in two parts
@@ -314,8 +683,8 @@ namespace NDiffMatchPatch
    * @return LinkedList of Diff objects.
    */
     private:
-        TDiffVector diff_bisectSplit( const std::wstring &text1, const std::wstring &text2, std::size_t x, std::size_t y, clock_t deadline );
-        TDiffVector diff_bisectSplit( const std::string &text1, const std::string &text2, std::size_t x, std::size_t y, clock_t deadline );
+        TDiffVector diff_bisectSplit( std::wstring_view text1, std::wstring_view text2, std::size_t x, std::size_t y, const SDeadline &deadline, SDiffContext &context );
+        TDiffVector diff_bisectSplit( const std::string &text1, const std::string &text2, std::size_t x, std::size_t y, const SDeadline &deadline, SDiffContext &context );
 
         /**
    * Split two texts into a list of strings.  Reduce the texts to a string of
@@ -332,6 +701,77 @@ namespace NDiffMatchPatch
         // elem 2 is TStringVector
         std::vector< TVariant > diff_linesToChars( const std::string &text1, const std::string &text2 );
 
+        /**
+   * Split two texts into a list of lines.  Reduce the texts to streams of
+   * 32-bit tokens where each token represents one unique line.  Unlike
+   * diff_linesToChars, lines are interned as views into the inputs (no
+   * per-line heap copy) and the token space is not limited by the width of
+   * wchar_t, so line mode handles more than 65,535 distinct lines.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The two token streams plus the list of unique line views.  The
+   *     zeroth line is intentionally blank.
+   */
+    protected:
+        SLineTokens diff_linesToTokens( const std::wstring &text1, const std::wstring &text2 );
+
+        /**
+   * Tokenize two texts at the given granularity.  Like diff_linesToTokens
+   * (which is the eLINE case) but the boundary scanner may end tokens at
+   * word or sentence breaks instead of newlines.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @param granularity Boundary at which to tokenize.
+   * @return The two token streams plus the list of unique token views.
+   */
+    protected:
+        SLineTokens diff_textToTokens( std::wstring_view text1, std::wstring_view text2, EDiffGranularity granularity );
+
+        /**
+   * Split a text into tokens at the given granularity and append one 32-bit
+   * token id per unique token.
+   * @param text Text to encode; the interned token views point into it.
+   * @param granularity Boundary at which to tokenize.
+   * @param lineArray List of unique token views.
+   * @param lineHash Map of token views to token ids.
+   * @return Encoded token stream.
+   */
+    private:
+        static std::u32string diff_textToTokensMunge( std::wstring_view text, EDiffGranularity granularity, TStringViewVector &lineArray, std::unordered_map< std::wstring_view, uint32_t > &lineHash );
+
+        /**
+   * Locate the end of the token beginning at start.
+   * @param text The text being tokenized.
+   * @param start Index of the first character of the token.
+   * @param granularity Boundary at which to tokenize.
+   * @return Index one past the last character of the token.
+   */
+    private:
+        static std::size_t diff_tokenEnd( std::wstring_view text, std::size_t start, EDiffGranularity granularity );
+
+        /**
+   * Diff two token streams produced by diff_linesToTokens, materializing the
+   * hunks back into line text as they are emitted.  Mirrors the structure of
+   * diff_main/diff_compute at token granularity.
+   * @param tokens1 Old token stream.
+   * @param tokens2 New token stream.
+   * @param lines List of unique line views from diff_linesToTokens.
+   * @param deadline Time at which to bail if not yet complete.
+   * @return Vector of Diff objects.
+   */
+    private:
+        TDiffVector diff_tokens( std::u32string_view tokens1, std::u32string_view tokens2, const TStringViewVector &lines, const SDeadline &deadline, SDiffContext &context );
+        TDiffVector diff_tokensCompute( std::u32string_view tokens1, std::u32string_view tokens2, const TStringViewVector &lines, const SDeadline &deadline, SDiffContext &context );
+
+        /**
+   * Concatenate the lines named by a token stream back into text.
+   * @param tokens Token stream.
+   * @param lines List of unique line views.
+   * @return The reassembled text.
+   */
+    private:
+        static std::wstring diff_tokensToText( std::u32string_view tokens, const TStringViewVector &lines );
+
         /**
    * Split a text into a list of strings.  Reduce the texts to a string of
    * hashes where each Unicode character represents one line.
@@ -397,20 +837,6 @@ namespace NDiffMatchPatch
         TStringVector diff_halfMatch( const std::wstring &text1, const std::wstring &text2 );
         TStringVector diff_halfMatch( const std::string &text1, const std::string &text2 );
 
-        /**
-   * Does a substring of shorttext exist within longtext such that the
-   * substring is at least half the length of longtext?
-   * @param longtext Longer string.
-   * @param shorttext Shorter string.
-   * @param i Start index of quarter length substring within longtext.
-   * @return Five element String array, containing the prefix of longtext, the
-   *     suffix of longtext, the prefix of shorttext, the suffix of shorttext
-   *     and the common middle.  Or null if there was no match.
-   */
-    private:
-        TStringVector diff_halfMatchI( const std::wstring &longtext, const std::wstring &shorttext, std::size_t i );
-        TStringVector diff_halfMatchI( const std::string &longtext, const std::string &shorttext, std::size_t i );
-
         /**
    * Reduce the number of edits by eliminating semantically trivial equalities.
    * @param diffs LinkedList of Diff objects.
@@ -436,7 +862,7 @@ namespace NDiffMatchPatch
    * @return The score.
    */
     private:
-        int64_t diff_cleanupSemanticScore( const std::wstring &one, const std::wstring &two );
+        int64_t diff_cleanupSemanticScore( std::wstring_view one, std::wstring_view two );
         int64_t diff_cleanupSemanticScore( const std::string &one, const std::string &two );
 
         /**
@@ -473,6 +899,15 @@ namespace NDiffMatchPatch
     public:
         std::wstring diff_prettyHtml( const TDiffVector &diffs );
 
+        /**
+   * Stream a pretty HTML report directly to a sink.  The escaped output is
+   * written in a single pass without building the report string first.
+   * @param diffs LinkedList of Diff objects.
+   * @param out Stream to write the HTML representation to.
+   */
+    public:
+        void diff_prettyHtml( const TDiffVector &diffs, std::wostream &out );
+
         /**
    * Convert a Diff list into a pretty Console report. Red for delete, and green for insert
    * @param diffs LinkedList of Diff objects.
@@ -481,6 +916,14 @@ namespace NDiffMatchPatch
     public:
         std::wstring diff_prettyConsole( const TDiffVector &diffs );
 
+        /**
+   * Stream a pretty Console report directly to a sink.
+   * @param diffs LinkedList of Diff objects.
+   * @param out Stream to write the Console representation to.
+   */
+    public:
+        void diff_prettyConsole( const TDiffVector &diffs, std::wostream &out );
+
         /**
    * Compute and return the source text (all equalities and deletions).
    * @param diffs LinkedList of Diff objects.
@@ -543,6 +986,20 @@ namespace NDiffMatchPatch
         std::size_t match_main( const std::wstring &text, const std::wstring &pattern, std::size_t loc );
         std::size_t match_main( const std::string &text, const std::string &pattern, std::size_t loc );
 
+        /**
+   * Locate 'pattern' in 'text' with per-call options, leaving this
+   * instance untouched.  Safe to call concurrently on one shared (const)
+   * instance.
+   * @param text The text to search.
+   * @param pattern The pattern to search for.
+   * @param loc The location to search around.
+   * @param options Knob values for this call only.
+   * @return Best match index or -1.
+   */
+        std::size_t match_main( const std::wstring &text, const std::wstring &pattern, std::size_t loc, const SOptions &options ) const;
+        std::size_t match_main( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc );
+        std::size_t match_main( const SIndexedText &text, const SMatchPattern &pattern, std::size_t loc );
+
         /**
    * Locate the best instance of 'pattern' in 'text' near 'loc' using the
    * Bitap algorithm.  Returns -1 if no match found.
@@ -554,6 +1011,20 @@ namespace NDiffMatchPatch
     protected:
         std::size_t match_bitap( const std::wstring &text, const std::wstring &pattern, std::size_t loc );
         std::size_t match_bitap( const std::string &text, const std::string &pattern, std::size_t loc );
+        std::size_t match_bitap( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc );
+        std::size_t match_bitap( const SIndexedText &text, const SMatchPattern &pattern, std::size_t loc );
+
+    private:
+        /**
+   * The bitap scan proper, after the exact-occurrence seeding has set the
+   * starting score threshold.
+   * @param text The text to search.
+   * @param pattern The precompiled pattern to search for.
+   * @param loc The location to search around.
+   * @param score_threshold Highest score beyond which the scan gives up.
+   * @return Best match index or -1.
+   */
+        std::size_t match_bitapCore( const std::wstring &text, const SMatchPattern &pattern, std::size_t loc, double score_threshold );
 
         /**
    * Compute and return the score for a match with e errors and x location.
@@ -587,6 +1058,19 @@ namespace NDiffMatchPatch
         void patch_addContext( Patch &patch, const std::wstring &text );
         void patch_addContext( Patch &patch, const std::string &text );
 
+        /**
+   * Increase the context until it is unique, answering repeated
+   * uniqueness probes from 'index'.  The index is built lazily (only
+   * once a first direct scan proves the context ambiguous) and is shared
+   * by every patch drawn from the same source text, so a patch set with
+   * hundreds of hunks no longer rescans the whole document per probe.
+   * @param patch The patch to grow.
+   * @param text Source text.
+   * @param index Lazily built q-gram index over 'text'.
+   */
+    private:
+        void patch_addContext( Patch &patch, const std::wstring &text, std::unique_ptr< SIndexedText > &index );
+
         /**
    * Compute a list of patches to turn text1 into text2.
    * A set of diffs will be computed.
@@ -652,6 +1136,33 @@ namespace NDiffMatchPatch
         std::pair< std::wstring, std::vector< bool > > patch_apply( TPatchVector patches, std::wstring text );
         std::pair< std::wstring, std::vector< bool > > patch_apply( TPatchVector patches, std::string text );
 
+        /**
+   * Merge a set of patches onto the text with per-call options, leaving
+   * this instance untouched.  Safe to call concurrently on one shared
+   * (const) instance.
+   * @param patches The patches to apply.
+   * @param text Old text.
+   * @param options Knob values for this call only.
+   * @return The new text and a vector of which patches applied.
+   */
+        std::pair< std::wstring, std::vector< bool > > patch_apply( TPatchVector patches, std::wstring text, const SOptions &options ) const;
+
+        /**
+   * Apply a set of patches in edit-buffer mode: every hunk is matched
+   * against the immutable original text (through a q-gram index built
+   * once), the resulting splices are accumulated, and the output is
+   * materialized in a single pass at the end instead of rebuilding the
+   * document after every hunk.  For the ordered, non-overlapping hunks
+   * patch_make produces this returns the same result as patch_apply;
+   * hunks that land on overlapping regions should use patch_apply, which
+   * rematches each hunk against the partially edited document.
+   * @param patches Array of patch objects.
+   * @param text Old text.
+   * @return Two element pair, containing the new text and a vector of
+   *      boolean values.
+   */
+        std::pair< std::wstring, std::vector< bool > > patch_applyBuffered( TPatchVector patches, const std::wstring &text );
+
         /**
    * Add some padding on text start and end so that edges can match something.
    * Intended to be called only from within patch_apply.
@@ -678,6 +1189,15 @@ namespace NDiffMatchPatch
     public:
         std::wstring patch_toText( const TPatchVector &patches );
 
+        /**
+   * Stream the textual representation of patches directly to a sink,
+   * one patch at a time, instead of concatenating it all first.
+   * @param patches List of Patch objects.
+   * @param out Stream to write the text representation to.
+   */
+    public:
+        void patch_toText( const TPatchVector &patches, std::wostream &out );
+
         /**
    * Parse a textual representation of patches and return a List of Patch
    * objects.
@@ -689,6 +1209,28 @@ namespace NDiffMatchPatch
         TPatchVector patch_fromText( const std::wstring &textline );
         TPatchVector patch_fromText( const std::string &textline );
 
+        /**
+   * Serialize a list of patches into the versioned binary format: a
+   * 4-byte magic/version header, then varint-coded coordinates and
+   * length-prefixed raw UTF-8 hunk texts.  Unlike patch_toText nothing is
+   * percent-encoded, so encoding is a single pass over the hunk bytes.
+   * @param patches List of Patch objects.
+   * @return Binary representation of patches.
+   */
+    public:
+        std::string patch_toBinary( const TPatchVector &patches );
+
+        /**
+   * Parse the binary representation produced by patch_toBinary.  Hunk
+   * texts are decoded straight out of the input buffer with no
+   * intermediate copies.
+   * @param data Binary representation of patches.
+   * @return List of Patch objects.
+   * @throws std::wstring If invalid input.
+   */
+    public:
+        TPatchVector patch_fromBinary( std::string_view data );
+
         /**
    * A safer version of std::wstring.mid(pos).  This one returns "" instead of
    * null when the postion equals the string length.
@@ -711,6 +1253,88 @@ namespace NDiffMatchPatch
         static std::wstring safeMid( const std::wstring &str, std::size_t pos, std::size_t len );
     };
 
+    /**
+ * Incremental diff session for successive versions of one document.  The
+ * session retains the latest version; each advance() diffs the retained
+ * text against the next version, trims the untouched prefix and suffix
+ * with direct block compares, and runs the diff engine only over the dirty
+ * window between them.  For a small edit into a large document the
+ * expensive part of the work is proportional to the edit, not the
+ * document.  One diff context (and thus one bisect workspace) is reused
+ * across every call.
+ *
+ * Engine settings are exposed through the public dmp member.
+ */
+    class incremental_diff_session
+    {
+    public:
+        incremental_diff_session() = default;
+        explicit incremental_diff_session( std::wstring initialText );
+
+        /**
+   * Replace the retained text without producing a diff.
+   * @param text The new baseline text.
+   */
+        void reset( std::wstring text );
+
+        /**
+   * Diff the retained text against the next version of the document and
+   * retain that version for the following call.
+   * @param newText The next version of the document.
+   * @return Diff list from the previously retained text to newText.
+   */
+        TDiffVector advance( std::wstring newText );
+
+        const std::wstring &text() const { return fText; }
+
+        diff_match_patch dmp;
+
+    private:
+        std::wstring fText;
+        diff_match_patch::SDiffContext fContext;
+    };
+
+    /**
+ * Position translation for one diff, built once and queried many times.
+ * diff_xIndex answers a single "where did this offset move" question by
+ * walking every hunk, so translating thousands of cursor or annotation
+ * positions through the same diff costs O(hunks) per query.  This map
+ * stores prefix sums of the hunk lengths over both texts and answers the
+ * same queries in O(log hunks), in either direction.  It copies nothing
+ * from the diff and stays valid after the diff itself is destroyed.
+ */
+    class diff_position_map
+    {
+    public:
+        explicit diff_position_map( const TDiffVector &diffs );
+
+        /**
+   * Translate a text1 offset to its text2 counterpart; identical results
+   * to diff_xIndex on the source diff.  Offsets inside a deletion map to
+   * the position where the deletion happened.
+   * @param loc Location within text1.
+   * @return Corresponding location within text2.
+   */
+        std::size_t toText2( std::size_t loc ) const;
+
+        /**
+   * Translate a text2 offset back to text1, the mirror query.  Offsets
+   * inside an insertion map to the insertion point within text1.
+   * @param loc Location within text2.
+   * @return Corresponding location within text1.
+   */
+        std::size_t toText1( std::size_t loc ) const;
+
+        std::size_t hunkCount() const { return fOps.size(); }
+
+    private:
+        std::size_t translate( const std::vector< std::size_t > &from, const std::vector< std::size_t > &to, EOperation removedBy, std::size_t loc ) const;
+
+        std::vector< std::size_t > fChars1;   // cumulative text1 length after each hunk
+        std::vector< std::size_t > fChars2;   // cumulative text2 length after each hunk
+        std::vector< EOperation > fOps;
+    };
+
     namespace NUtils
     {
         std::wstring to_wstring( const diff_match_patch::TVariant &variant, bool doubleQuoteEmpty );
@@ -0,0 +1,227 @@
+/*
+ * Diff Match and Patch -- Benchmark Suite
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Google Benchmark suite for the cpp17 port, the counterpart of the other
+ * ports' speed tests (python3/tests/speedtest.py and friends).  Runs the
+ * shared speedtest corpus plus synthetic large and hunk-heavy inputs
+ * through the diff, match and patch hot paths.
+ *
+ * Build with -DUSE_BENCHMARK=ON (requires google-benchmark); run:
+ *   ./diff_match_patch_cpp17_bench
+ */
+
+#include "diff_match_patch.h"
+
+#include "benchmark/benchmark.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    using NDiffMatchPatch::diff_match_patch;
+    using NDiffMatchPatch::Diff;
+    using NDiffMatchPatch::EOperation;
+    using NDiffMatchPatch::TDiffVector;
+
+    // Expose the protected bisect entry point to the suite.
+    struct diff_match_patch_bench : public diff_match_patch
+    {
+        using diff_match_patch::diff_bisect;
+    };
+
+    std::wstring loadCorpus( const char *fileName )
+    {
+        std::ifstream ifs( std::string( SPEEDTEST_CORPUS_DIR ) + "/" + fileName, std::ios::binary );
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+        auto bytes = buffer.str();
+        // Widen byte for byte; the corpus is treated as Latin-1 so loading
+        // never depends on the global locale.
+        return std::wstring( bytes.begin(), bytes.end() );
+    }
+
+    const std::wstring &corpus1()
+    {
+        static const std::wstring text = loadCorpus( "speedtest1.txt" );
+        return text;
+    }
+
+    const std::wstring &corpus2()
+    {
+        static const std::wstring text = loadCorpus( "speedtest2.txt" );
+        return text;
+    }
+
+    // A large synthetic pair: many repeated lines with scattered edits.
+    std::wstring syntheticText( bool mutated )
+    {
+        std::wstring text;
+        for ( int ii = 0; ii < 4000; ++ii )
+        {
+            if ( mutated && ( ii % 13 == 0 ) )
+            {
+                text += L"line " + std::to_wstring( ii ) + L" has been rewritten entirely\n";
+            }
+            else
+            {
+                text += L"line " + std::to_wstring( ii ) + L" of the synthetic corpus\n";
+            }
+        }
+        return text;
+    }
+
+    // A diff with very many small hunks, the shape that stresses cleanup.
+    TDiffVector hunkHeavyDiffs()
+    {
+        TDiffVector diffs;
+        for ( int ii = 0; ii < 10000; ++ii )
+        {
+            diffs.emplace_back( EOperation::eEQUAL, L"stable text " + std::to_wstring( ii ) );
+            diffs.emplace_back( EOperation::eDELETE, L"old" + std::to_wstring( ii ) );
+            diffs.emplace_back( EOperation::eINSERT, L"new" + std::to_wstring( ii ) );
+        }
+        return diffs;
+    }
+
+    void BM_DiffMain_CharMode( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.diff_main( corpus1(), corpus2(), false ) );
+        }
+    }
+    BENCHMARK( BM_DiffMain_CharMode )->Unit( benchmark::kMillisecond );
+
+    void BM_DiffMain_LineMode( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.diff_main( corpus1(), corpus2(), true ) );
+        }
+    }
+    BENCHMARK( BM_DiffMain_LineMode )->Unit( benchmark::kMillisecond );
+
+    void BM_DiffMain_Synthetic( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        const auto text1 = syntheticText( false );
+        const auto text2 = syntheticText( true );
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.diff_main( text1, text2, true ) );
+        }
+    }
+    BENCHMARK( BM_DiffMain_Synthetic )->Unit( benchmark::kMillisecond );
+
+    void BM_DiffBisect( benchmark::State &state )
+    {
+        diff_match_patch_bench dmp;
+        const NDiffMatchPatch::SDeadline deadline;
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.diff_bisect( corpus1(), corpus2(), deadline ) );
+        }
+    }
+    BENCHMARK( BM_DiffBisect )->Unit( benchmark::kMillisecond );
+
+    void BM_DiffCleanupSemantic( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        const auto diffs = hunkHeavyDiffs();
+        for ( auto _ : state )
+        {
+            auto copy = diffs;
+            dmp.diff_cleanupSemantic( copy );
+            benchmark::DoNotOptimize( copy );
+        }
+    }
+    BENCHMARK( BM_DiffCleanupSemantic )->Unit( benchmark::kMillisecond );
+
+    void BM_MatchBitap( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        const auto &text = corpus1();
+        // A slightly mutated mid-corpus excerpt so the exact-match shortcut
+        // does not bypass bitap.
+        auto pattern = text.substr( text.length() / 2, 28 );
+        pattern[ 3 ] = ( pattern[ 3 ] == L'x' ) ? L'y' : L'x';
+        const auto loc = text.length() / 2 + 100;
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.match_main( text, pattern, loc ) );
+        }
+    }
+    BENCHMARK( BM_MatchBitap );
+
+    void BM_PatchMake( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.patch_make( corpus1(), corpus2() ) );
+        }
+    }
+    BENCHMARK( BM_PatchMake )->Unit( benchmark::kMillisecond );
+
+    void BM_PatchApply( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        const auto patches = dmp.patch_make( corpus1(), corpus2() );
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.patch_apply( patches, corpus1() ) );
+        }
+    }
+    BENCHMARK( BM_PatchApply )->Unit( benchmark::kMillisecond );
+
+    void BM_PatchToText( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        const auto patches = dmp.patch_make( corpus1(), corpus2() );
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.patch_toText( patches ) );
+        }
+    }
+    BENCHMARK( BM_PatchToText )->Unit( benchmark::kMillisecond );
+
+    void BM_PatchFromText( benchmark::State &state )
+    {
+        diff_match_patch dmp;
+        dmp.Diff_Timeout = 0;
+        const auto text = dmp.patch_toText( dmp.patch_make( corpus1(), corpus2() ) );
+        for ( auto _ : state )
+        {
+            benchmark::DoNotOptimize( dmp.patch_fromText( text ) );
+        }
+    }
+    BENCHMARK( BM_PatchFromText )->Unit( benchmark::kMillisecond );
+}
+
+BENCHMARK_MAIN();
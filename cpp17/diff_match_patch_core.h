@@ -0,0 +1,539 @@
+/*
+ * Diff Match and Patch
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DIFF_MATCH_PATCH_CORE_H
+#define DIFF_MATCH_PATCH_CORE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Character-type-agnostic core of the diff algorithms.
+ *
+ * The hot kernels (common prefix/suffix/overlap scans, the Myers bisect and
+ * the half-match probe) are templated on the character type so each engine
+ * runs at its natural element width: the byte engine works on char (1 byte
+ * per element) instead of dragging everything through a 2- or 4-byte
+ * wchar_t, roughly doubling or quadrupling effective memory bandwidth in the
+ * character-compare loops.  Everything operates on basic_string_view, so no
+ * kernel ever copies its inputs.
+ *
+ * diff_match_patch (wchar_t) and diff_match_patch_utf8 (char) are facades
+ * over these kernels; they keep ownership of recursion, cleanup and the
+ * result representation.
+ */
+
+namespace NDiffMatchPatch
+{
+    /**
+ * Deadline for a diff computation: a steady-clock time point plus an
+ * optional caller-owned cancellation flag.  The previous clock()-based
+ * deadline measured CPU time of the whole process, so wall-clock timeouts
+ * shrank as worker threads were added.  hitDeadline() checks the
+ * cancellation flag on every call but decimates the clock reads through a
+ * small countdown, keeping the poll cheap inside the bisect loop.
+ * Default-constructed deadlines never expire.
+ */
+    struct SDeadline
+    {
+        // Number of hitDeadline() calls per clock read.
+        static constexpr int kPollInterval = 16;
+
+        SDeadline() = default;
+
+        explicit SDeadline( float timeoutSeconds, const std::atomic< bool > *cancelled = nullptr ) :
+            fCancelled( cancelled )
+        {
+            if ( timeoutSeconds > 0 )
+            {
+                fWhen = std::chrono::steady_clock::now() + std::chrono::duration_cast< std::chrono::steady_clock::duration >( std::chrono::duration< float >( timeoutSeconds ) );
+            }
+        }
+
+        // A deadline that has already passed; every poll reports expiry.
+        static SDeadline expired()
+        {
+            SDeadline deadline;
+            deadline.fWhen = std::chrono::steady_clock::time_point::min();
+            return deadline;
+        }
+
+        bool hitDeadline() const
+        {
+            if ( fCancelled && fCancelled->load( std::memory_order_relaxed ) )
+            {
+                return true;
+            }
+            if ( --fCountdown > 0 )
+            {
+                return false;
+            }
+            fCountdown = kPollInterval;
+            return std::chrono::steady_clock::now() > fWhen;
+        }
+
+        std::chrono::steady_clock::time_point fWhen{ std::chrono::steady_clock::time_point::max() };
+        const std::atomic< bool > *fCancelled{ nullptr };
+        mutable int fCountdown{ 1 };
+    };
+
+    template< typename CharT >
+    class basic_diff_match_patch
+    {
+    public:
+        using char_type = CharT;
+        using string_type = std::basic_string< CharT >;
+        using string_view_type = std::basic_string_view< CharT >;
+        using TStringViewVector = std::vector< string_view_type >;
+
+        // Width (in bytes) of the blocks compared at a time by the common
+        // prefix/suffix scans; one 256-bit vector register.
+        static constexpr std::size_t kBlockBytes = 32;
+
+        /**
+   * Determine the common prefix of two strings.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The number of characters common to the start of each string.
+   */
+        static std::size_t diff_commonPrefix( string_view_type text1, string_view_type text2 )
+        {
+            // Performance analysis: http://neil.fraser.name/news/2007/10/09/
+            const auto n = std::min( text1.length(), text2.length() );
+            // Compare a vector-register-sized block at a time; memcmp lowers
+            // to SSE2/NEON compares on every mainstream compiler, so the scan
+            // runs at memory bandwidth instead of one element per iteration.
+            constexpr std::size_t kBlock = ( kBlockBytes + sizeof( CharT ) - 1 ) / sizeof( CharT );
+            std::size_t i = 0;
+            while ( ( ( i + kBlock ) <= n ) && ( std::memcmp( text1.data() + i, text2.data() + i, kBlock * sizeof( CharT ) ) == 0 ) )
+            {
+                i += kBlock;
+            }
+            // Locate the exact mismatch within the last block (or the tail).
+            while ( ( i < n ) && ( text1[ i ] == text2[ i ] ) )
+            {
+                i++;
+            }
+            return i;
+        }
+
+        /**
+   * Determine the common suffix of two strings.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The number of characters common to the end of each string.
+   */
+        static std::size_t diff_commonSuffix( string_view_type text1, string_view_type text2 )
+        {
+            // Performance analysis: http://neil.fraser.name/news/2007/10/09/
+            const auto text1_length = text1.length();
+            const auto text2_length = text2.length();
+            const auto n = std::min( text1_length, text2_length );
+            // Same block-compare idea as diff_commonPrefix, walking backwards.
+            constexpr std::size_t kBlock = ( kBlockBytes + sizeof( CharT ) - 1 ) / sizeof( CharT );
+            std::size_t i = 0;
+            while ( ( ( i + kBlock ) <= n ) && ( std::memcmp( text1.data() + text1_length - i - kBlock, text2.data() + text2_length - i - kBlock, kBlock * sizeof( CharT ) ) == 0 ) )
+            {
+                i += kBlock;
+            }
+            // Locate the exact mismatch within the last block (or the tail).
+            while ( ( i < n ) && ( text1[ text1_length - i - 1 ] == text2[ text2_length - i - 1 ] ) )
+            {
+                i++;
+            }
+            return i;
+        }
+
+        /**
+   * Determine if the suffix of one string is the prefix of another.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The number of characters common to the end of the first
+   *     string and the start of the second string.
+   */
+        static std::size_t diff_commonOverlap( string_view_type text1, string_view_type text2 )
+        {
+            // Cache the text lengths to prevent multiple calls.
+            const auto text1_length = text1.length();
+            const auto text2_length = text2.length();
+            // Eliminate the nullptr case.
+            if ( text1_length == 0 || text2_length == 0 )
+            {
+                return 0;
+            }
+            // Truncate the longer string.
+            auto text1_trunc = text1;
+            auto text2_trunc = text2;
+            if ( text1_length > text2_length )
+            {
+                text1_trunc = text1.substr( text1_length - text2_length );
+            }
+            else if ( text1_length < text2_length )
+            {
+                text2_trunc = text2.substr( 0, text1_length );
+            }
+            const auto text_length = std::min( text1_length, text2_length );
+            // Quick check for the worst case.
+            if ( text1_trunc == text2_trunc )
+            {
+                return text_length;
+            }
+
+            // Start by looking for a single character match
+            // and increase length until no match is found.
+            // Performance analysis: http://neil.fraser.name/news/2010/11/04/
+            std::size_t best = 0;
+            std::size_t length = 1;
+            while ( true )
+            {
+                auto pattern = ( length < text1_trunc.length() ) ? text1_trunc.substr( text_length - length ) : string_view_type();
+                if ( pattern.empty() )
+                    return best;
+
+                auto found = text2_trunc.find( pattern );
+                if ( found == string_view_type::npos )
+                {
+                    return best;
+                }
+                length += found;
+                if ( found == 0 || text1_trunc.substr( text_length - length ) == text2_trunc.substr( 0, length ) )
+                {
+                    best = length;
+                    length++;
+                }
+            }
+        }
+
+        /**
+   * Reusable scratch space for diff_bisect.  The bisect recursion allocates
+   * its two V arrays fresh on every (sub-)problem; sharing one workspace
+   * across the whole recursion turns those into amortized O(1) assigns into
+   * already-grown buffers.  A workspace is cheap to default-construct, is
+   * not thread-safe, and holds no state between calls beyond capacity and
+   * the visibility counters below.
+   */
+        struct SBisectWorkspace
+        {
+            std::vector< int64_t > fV1;
+            std::vector< int64_t > fV2;
+            // Cumulative count of Myers d-loop steps; reset by the caller.
+            std::size_t fIterations{ 0 };
+            // Whether the last bisect bailed out on the deadline rather than
+            // finding a split point or exhausting the edit graph.
+            bool fHitDeadline{ false };
+        };
+
+        /**
+   * Find the 'middle snake' of a diff.
+   * See Myers 1986 paper: An O(ND) Difference Algorithm and Its Variations.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @param deadline Deadline/cancellation checked while walking the paths.
+   * @param x Receives the index of the split point in text1.
+   * @param y Receives the index of the split point in text2.
+   * @return true if a split point was found; false if the deadline was hit
+   *     or the texts share no commonality at all.
+   */
+        static bool diff_bisect( string_view_type text1, string_view_type text2, const SDeadline &deadline, std::size_t &x, std::size_t &y )
+        {
+            SBisectWorkspace workspace;
+            return diff_bisect( text1, text2, deadline, x, y, workspace );
+        }
+
+        static bool diff_bisect( string_view_type text1, string_view_type text2, const SDeadline &deadline, std::size_t &x, std::size_t &y, SBisectWorkspace &workspace )
+        {
+            // using int64_t rather than size_t due to the backward walking
+            // nature of the algorithm
+
+            // Cache the text lengths to prevent multiple calls.
+            auto text1_length = static_cast< int64_t >( text1.length() );
+            auto text2_length = static_cast< int64_t >( text2.length() );
+            auto max_d = ( text1_length + text2_length + 1 ) / 2;
+            auto v_offset = max_d;
+            auto v_length = 2 * max_d;
+            auto &v1 = workspace.fV1;
+            auto &v2 = workspace.fV2;
+            v1.assign( v_length, -1 );
+            v2.assign( v_length, -1 );
+            v1[ v_offset + 1 ] = 0;
+            v2[ v_offset + 1 ] = 0;
+            auto delta = text1_length - text2_length;
+            // If the total number of characters is odd, then the front path will
+            // collide with the reverse path.
+            bool front = ( delta % 2 != 0 );
+            // Offsets for start and end of k loop.
+            // Prevents mapping of space beyond the grid.
+            int64_t k1start = 0;
+            int64_t k1end = 0;
+            int64_t k2start = 0;
+            int64_t k2end = 0;
+            workspace.fHitDeadline = false;
+            for ( int64_t d = 0; d < max_d; d++ )
+            {
+                // Bail out if deadline is reached or the caller cancelled.
+                if ( deadline.hitDeadline() )
+                {
+                    workspace.fHitDeadline = true;
+                    break;
+                }
+                workspace.fIterations++;
+
+                // Walk the front path one step.
+                for ( auto k1 = -d + k1start; k1 <= d - k1end; k1 += 2 )
+                {
+                    auto k1_offset = v_offset + k1;
+                    int64_t x1;
+                    if ( ( k1 == -d ) || ( k1 != d ) && ( v1[ k1_offset - 1 ] < v1[ k1_offset + 1 ] ) )
+                    {
+                        x1 = v1[ k1_offset + 1 ];
+                    }
+                    else
+                    {
+                        x1 = v1[ k1_offset - 1 ] + 1;
+                    }
+                    int64_t y1 = x1 - k1;
+                    while ( ( x1 < text1_length ) && ( y1 < text2_length ) && ( text1[ x1 ] == text2[ y1 ] ) )
+                    {
+                        x1++;
+                        y1++;
+                    }
+                    v1[ k1_offset ] = x1;
+                    if ( x1 > text1_length )
+                    {
+                        // Ran off the right of the graph.
+                        k1end += 2;
+                    }
+                    else if ( y1 > text2_length )
+                    {
+                        // Ran off the bottom of the graph.
+                        k1start += 2;
+                    }
+                    else if ( front )
+                    {
+                        auto k2_offset = v_offset + delta - k1;
+                        if ( ( k2_offset >= 0 ) && ( k2_offset < v_length ) && ( v2[ k2_offset ] != -1 ) )
+                        {
+                            // Mirror x2 onto top-left coordinate system.
+                            auto x2 = text1_length - v2[ k2_offset ];
+                            if ( x1 >= x2 )
+                            {
+                                // Overlap detected.
+                                x = x1;
+                                y = y1;
+                                return true;
+                            }
+                        }
+                    }
+                }
+
+                // Walk the reverse path one step.
+                for ( auto k2 = -d + k2start; k2 <= d - k2end; k2 += 2 )
+                {
+                    auto k2_offset = v_offset + k2;
+                    int64_t x2;
+                    if ( ( k2 == -d ) || ( k2 != d ) && ( v2[ k2_offset - 1 ] < v2[ k2_offset + 1 ] ) )
+                    {
+                        x2 = v2[ k2_offset + 1 ];
+                    }
+                    else
+                    {
+                        x2 = v2[ k2_offset - 1 ] + 1;
+                    }
+                    auto y2 = x2 - k2;
+                    while ( ( x2 < text1_length ) && ( y2 < text2_length ) && ( text1[ text1_length - x2 - 1 ] == text2[ text2_length - y2 - 1 ] ) )
+                    {
+                        x2++;
+                        y2++;
+                    }
+                    v2[ k2_offset ] = x2;
+                    if ( x2 > text1_length )
+                    {
+                        // Ran off the left of the graph.
+                        k2end += 2;
+                    }
+                    else if ( y2 > text2_length )
+                    {
+                        // Ran off the top of the graph.
+                        k2start += 2;
+                    }
+                    else if ( !front )
+                    {
+                        auto k1_offset = v_offset + delta - k2;
+                        if ( ( k1_offset >= 0 ) && ( k1_offset < v_length ) && ( v1[ k1_offset ] != -1 ) )
+                        {
+                            auto x1 = v1[ k1_offset ];
+                            auto y1 = v_offset + x1 - k1_offset;
+                            // Mirror x2 onto top-left coordinate system.
+                            x2 = text1_length - v2[ k2_offset ];
+                            if ( x1 >= x2 )
+                            {
+                                // Overlap detected.
+                                x = x1;
+                                y = y1;
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+            // Diff took too long and hit the deadline or
+            // number of diffs equals number of characters, no commonality at all.
+            return false;
+        }
+
+        /**
+   * Do the two texts share a substring which is at least half the length of
+   * the longer text?
+   * This speedup can produce non-minimal diffs.
+   * The timeout policy check (only probe when a timeout is in force) is the
+   * caller's responsibility.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return Five element vector of views into the inputs, containing the
+   *     prefix of text1, the suffix of text1, the prefix of text2, the
+   *     suffix of text2 and the common middle.  Or empty if there was no
+   *     match.
+   */
+        static TStringViewVector diff_halfMatch( string_view_type text1, string_view_type text2 )
+        {
+            const auto longtext = text1.length() > text2.length() ? text1 : text2;
+            const auto shorttext = text1.length() > text2.length() ? text2 : text1;
+            if ( ( longtext.length() < 4 ) || ( ( shorttext.length() * 2 ) < longtext.length() ) )
+            {
+                return {};   // Pointless.
+            }
+
+            // First check if the second quarter is the seed for a half-match.
+            const auto hm1 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 3 ) / 4 );
+            // Check again based on the third quarter.
+            const auto hm2 = diff_halfMatchI( longtext, shorttext, ( longtext.length() + 1 ) / 2 );
+            TStringViewVector hm;
+            if ( hm1.empty() && hm2.empty() )
+            {
+                return {};
+            }
+            else if ( hm2.empty() )
+            {
+                hm = hm1;
+            }
+            else if ( hm1.empty() )
+            {
+                hm = hm2;
+            }
+            else
+            {
+                // Both matched.  Select the longest.
+                hm = hm1[ 4 ].length() > hm2[ 4 ].length() ? hm1 : hm2;
+            }
+
+            // A half-match was found, sort out the return data.
+            if ( text1.length() > text2.length() )
+            {
+                return hm;
+            }
+            return TStringViewVector( { hm[ 2 ], hm[ 3 ], hm[ 0 ], hm[ 1 ], hm[ 4 ] } );
+        }
+
+    private:
+        /**
+   * Does a substring of shorttext exist within longtext such that the
+   * substring is at least half the length of longtext?
+   * @param longtext Longer string.
+   * @param shorttext Shorter string.
+   * @param i Start index of quarter length substring within longtext.
+   * @return Five element vector of views, or empty if there was no match.
+   */
+        static TStringViewVector diff_halfMatchI( string_view_type longtext, string_view_type shorttext, std::size_t i )
+        {
+            // Start with a 1/4 length substring at position i as a seed.
+            const auto seed = longtext.substr( i, longtext.length() / 4 );
+            if ( seed.empty() || ( shorttext.length() < seed.length() ) )
+            {
+                return {};
+            }
+
+            // Candidate positions come from a single Rabin-Karp scan of the
+            // short text rather than repeated find() probes; hash hits are
+            // verified with a direct compare before extending.
+            using THashChar = typename std::make_unsigned< char_type >::type;
+            constexpr uint64_t kHashBase = 1099511628211ULL;
+            uint64_t seedHash = 0;
+            uint64_t windowHash = 0;
+            uint64_t highPower = 1;   // kHashBase^(seed.length()-1)
+            for ( std::size_t k = 0; k < seed.length(); ++k )
+            {
+                seedHash = seedHash * kHashBase + static_cast< THashChar >( seed[ k ] );
+                windowHash = windowHash * kHashBase + static_cast< THashChar >( shorttext[ k ] );
+                if ( k + 1 < seed.length() )
+                {
+                    highPower *= kHashBase;
+                }
+            }
+
+            string_view_type best_common_a;
+            string_view_type best_common_b;
+            string_view_type best_longtext_a, best_longtext_b;
+            string_view_type best_shorttext_a, best_shorttext_b;
+            for ( std::size_t j = 0;; ++j )
+            {
+                if ( ( windowHash == seedHash ) && ( shorttext.compare( j, seed.length(), seed ) == 0 ) )
+                {
+                    const auto prefixLength = diff_commonPrefix( longtext.substr( i ), shorttext.substr( j ) );
+                    const auto suffixLength = diff_commonSuffix( longtext.substr( 0, i ), shorttext.substr( 0, j ) );
+                    if ( ( best_common_a.length() + best_common_b.length() ) < ( suffixLength + prefixLength ) )
+                    {
+                        best_common_a = shorttext.substr( j - suffixLength, suffixLength );
+                        best_common_b = shorttext.substr( j, prefixLength );
+                        best_longtext_a = longtext.substr( 0, i - suffixLength );
+                        best_longtext_b = longtext.substr( i + prefixLength );
+                        best_shorttext_a = shorttext.substr( 0, j - suffixLength );
+                        best_shorttext_b = shorttext.substr( j + prefixLength );
+                    }
+                }
+                if ( ( j + seed.length() ) >= shorttext.length() )
+                {
+                    break;
+                }
+                windowHash -= highPower * static_cast< THashChar >( shorttext[ j ] );
+                windowHash = windowHash * kHashBase + static_cast< THashChar >( shorttext[ j + seed.length() ] );
+            }
+            if ( ( best_common_a.length() + best_common_b.length() ) * 2 >= longtext.length() )
+            {
+                // The common middle is the suffix run followed by the prefix run;
+                // both are views into shorttext and the runs are adjacent there,
+                // so the combined region is itself a single contiguous view.
+                auto combined = shorttext.substr( best_shorttext_a.length(), best_common_a.length() + best_common_b.length() );
+                return TStringViewVector( { best_longtext_a, best_longtext_b, best_shorttext_a, best_shorttext_b, combined } );
+            }
+            return {};
+        }
+    };
+
+    extern template class basic_diff_match_patch< char >;
+    extern template class basic_diff_match_patch< char16_t >;
+    extern template class basic_diff_match_patch< char32_t >;
+    extern template class basic_diff_match_patch< wchar_t >;
+}
+#endif   // DIFF_MATCH_PATCH_CORE_H
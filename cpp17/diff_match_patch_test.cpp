@@ -17,6 +17,8 @@
  */
 
 #include "diff_match_patch.h"
+#include "diff_match_patch_core.h"
+#include "diff_match_patch_utf8.h"
 
 #include "diff_match_patch_test.h"
 #include "diff_match_patch_utils.h"
@@ -26,7 +28,12 @@
 #endif
 
 #include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include <codecvt>
 #include <locale>
 
@@ -36,7 +43,7 @@ int main( int argc, char **argv )
     ::testing::InitGoogleTest( &argc, argv );
     int retVal = RUN_ALL_TESTS();
 #else
-    diff_match_patch_test dmp_test;
+    NDiffMatchPatch::diff_match_patch_test dmp_test;
     std::cerr << "Starting diff_match_patch unit tests.\n";
     int retVal = dmp_test.run_all_tests();
     std::cerr << "Done.\n";
@@ -89,6 +96,8 @@ namespace NDiffMatchPatch
         runTest( std::bind( &diff_match_patch_test::testDiffCommonOverlap, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffHalfmatch, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffLinesToChars, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffLinesToTokens, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffGranularity, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffCharsToLines, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffCleanupMerge, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffCleanupSemanticLossless, this ) );
@@ -102,19 +111,35 @@ namespace NDiffMatchPatch
         runTest( std::bind( &diff_match_patch_test::testDiffLevenshtein, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffBisect, this ) );
         runTest( std::bind( &diff_match_patch_test::testDiffMain, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffMainSpans, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffThreads, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffCancel, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffBatch, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffStats, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffOptions, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffMainAsync, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffPositionMap, this ) );
+        runTest( std::bind( &diff_match_patch_test::testIncrementalDiff, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffMainUtf8, this ) );
+        runTest( std::bind( &diff_match_patch_test::testDiffFiles, this ) );
 
         runTest( std::bind( &diff_match_patch_test::testMatchAlphabet, this ) );
         runTest( std::bind( &diff_match_patch_test::testMatchBitap, this ) );
+        runTest( std::bind( &diff_match_patch_test::testMatchBitapLong, this ) );
+        runTest( std::bind( &diff_match_patch_test::testMatchPattern, this ) );
+        runTest( std::bind( &diff_match_patch_test::testIndexedText, this ) );
         runTest( std::bind( &diff_match_patch_test::testMatchMain, this ) );
 
         runTest( std::bind( &diff_match_patch_test::testPatchObj, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchFromText, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchToText, this ) );
+        runTest( std::bind( &diff_match_patch_test::testPatchBinary, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchAddContext, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchMake, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchSplitMax, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchAddPadding, this ) );
         runTest( std::bind( &diff_match_patch_test::testPatchApply, this ) );
+        runTest( std::bind( &diff_match_patch_test::testPatchApplyBuffered, this ) );
         if ( numFailedTests == 0 )
             std::cout << numPassedTests << " Tests Passed\n" << numFailedTests << " Tests Failed\n";
         else
@@ -136,10 +161,28 @@ namespace NDiffMatchPatch
         assertEquals( "diff_commonPrefix: Non-nullptr case.", 4, dmp.diff_commonPrefix( "1234abcdef", "1234xyz" ) );
 
         assertEquals( "diff_commonPrefix: Whole case.", 4, dmp.diff_commonPrefix( "1234", "1234xyz" ) );
+
+        // The templated core is instantiated for all supported widths.
+        assertEquals( "diff_commonPrefix: char16_t case.", 4, basic_diff_match_patch< char16_t >::diff_commonPrefix( u"1234abcdef", u"1234xyz" ) );
+
+        // Long inputs exercise the block-compare fast path and its tail.
+        std::wstring longText1( 1000, L'x' );
+        auto longText2 = longText1;
+        assertEquals( "diff_commonPrefix: Long equal case.", 1000, dmp.diff_commonPrefix( longText1, longText2 ) );
+        longText2[ 997 ] = L'y';
+        assertEquals( "diff_commonPrefix: Long mismatch case.", 997, dmp.diff_commonPrefix( longText1, longText2 ) );
     }
 
     TEST_F( diff_match_patch_test, testDiffCommonSuffix )
     {
+        // Long inputs exercise the block-compare fast path and its tail.
+        {
+            std::wstring longText1( 1000, L'x' );
+            auto longText2 = longText1;
+            assertEquals( "diff_commonSuffix: Long equal case.", 1000, dmp.diff_commonSuffix( longText1, longText2 ) );
+            longText2[ 2 ] = L'y';
+            assertEquals( "diff_commonSuffix: Long mismatch case.", 997, dmp.diff_commonSuffix( longText1, longText2 ) );
+        }
         // Detect any common suffix.
         assertEquals( "diff_commonSuffix: nullptr case.", 0, dmp.diff_commonSuffix( "abc", "xyz" ) );
 
@@ -461,6 +504,11 @@ namespace NDiffMatchPatch
             L"style=\"background:#ffe6e6;\">&lt;B&gt;b&lt;/B&gt;</del><ins "
             L"style=\"background:#e6ffe6;\">c&amp;d</ins>",
             dmp.diff_prettyHtml( diffs ) );
+
+        // The streaming sink produces the identical report.
+        std::wostringstream sink;
+        dmp.diff_prettyHtml( diffs, sink );
+        assertEquals( "diff_prettyHtml: Stream sink.", dmp.diff_prettyHtml( diffs ), sink.str() );
     }
 
     TEST_F( diff_match_patch_test, testDiffPrettyConsole )
@@ -475,6 +523,11 @@ namespace NDiffMatchPatch
         auto diffs = TDiffVector( { Diff( EOperation::eEQUAL, "a\n" ), Diff( EOperation::eDELETE, "<B>b</B>" ), Diff( EOperation::eINSERT, "c&d" ) } );
         auto results = dmp.diff_prettyConsole( diffs );
         assertEquals( "diff_prettyConsole:", L"a" + kEOL + kRed + L"<B>b</B>" + kReset + kGreen + L"c&d" + kReset, results );
+
+        // The streaming sink produces the identical report.
+        std::wostringstream sink;
+        dmp.diff_prettyConsole( diffs, sink );
+        assertEquals( "diff_prettyConsole: Stream sink.", results, sink.str() );
     }
 
     TEST_F( diff_match_patch_test, testDiffText )
@@ -508,6 +561,9 @@ namespace NDiffMatchPatch
         // Generates error (%c3%xy invalid Unicode).
         assertThrow( "diff_fromDelta: Invalid character.", dmp.diff_fromDelta( "", "+%c3%xy" ), std::wstring );
 
+        // Generates error (count overflows int64, treated as invalid).
+        assertThrow( "diff_fromDelta: Oversized count.", dmp.diff_fromDelta( "a", "=99999999999999999999" ), std::wstring );
+
         // Test deltas with special characters.
         diffs = { Diff( EOperation::eEQUAL, std::wstring( L"\u0680 " ) + kZero + std::wstring( L" \t %" ) ), Diff( EOperation::eDELETE, std::wstring( L"\u0681 " ) + kOne + std::wstring( L" \n ^" ) ), Diff( EOperation::eINSERT, std::wstring( L"\u0682 " ) + kTwo + std::wstring( L" \\ |" ) ) };
 
@@ -542,6 +598,52 @@ namespace NDiffMatchPatch
         assertEquals( "diff_xIndex: Translation on deletion.", 1, dmp.diff_xIndex( diffs, 3 ) );
     }
 
+    TEST_F( diff_match_patch_test, testDiffPositionMap )
+    {
+        // The map answers the same queries as diff_xIndex.
+        auto diffs = TDiffVector( { Diff( EOperation::eDELETE, "a" ), Diff( EOperation::eINSERT, "1234" ), Diff( EOperation::eEQUAL, "xyz" ) } );
+        auto map = diff_position_map( diffs );
+        assertEquals( "diff_position_map: Translation on equality.", 5, map.toText2( 2 ) );
+
+        diffs = { Diff( EOperation::eEQUAL, "a" ), Diff( EOperation::eDELETE, "1234" ), Diff( EOperation::eEQUAL, "xyz" ) };
+        map = diff_position_map( diffs );
+        assertEquals( "diff_position_map: Translation on deletion.", 1, map.toText2( 3 ) );
+
+        // Every position of a real diff agrees with diff_xIndex in both
+        // directions; the reverse query is diff_xIndex over the flipped diff.
+        std::wstring text1;
+        std::wstring text2;
+        for ( int ii = 0; ii < 100; ++ii )
+        {
+            auto num = std::to_wstring( ii );
+            text1 += L"line " + num + L": the quick brown fox jumps over the lazy dog\n";
+            text2 += L"line " + num + ( ( ii % 5 == 0 ) ? L": the slow red fox strolls past the lazy dog\n" : L": the quick brown fox jumps over the lazy dog\n" );
+        }
+        diffs = dmp.diff_main( text1, text2 );
+        auto flipped = diffs;
+        for ( auto &&aDiff : flipped )
+        {
+            if ( aDiff.isDelete() )
+                aDiff.fOperation = EOperation::eINSERT;
+            else if ( aDiff.isInsert() )
+                aDiff.fOperation = EOperation::eDELETE;
+        }
+        map = diff_position_map( diffs );
+        assertEquals( "diff_position_map: Hunks recorded.", diffs.size(), map.hunkCount() );
+        bool forwardMatch = true;
+        for ( std::size_t loc = 0; loc <= text1.length(); ++loc )
+            forwardMatch = forwardMatch && ( map.toText2( loc ) == dmp.diff_xIndex( diffs, loc ) );
+        assertTrue( "diff_position_map: Forward queries match diff_xIndex.", forwardMatch );
+        bool reverseMatch = true;
+        for ( std::size_t loc = 0; loc <= text2.length(); ++loc )
+            reverseMatch = reverseMatch && ( map.toText1( loc ) == dmp.diff_xIndex( flipped, loc ) );
+        assertTrue( "diff_position_map: Reverse queries match diff_xIndex.", reverseMatch );
+
+        // An empty diff translates positions unchanged.
+        map = diff_position_map( TDiffVector() );
+        assertEquals( "diff_position_map: Empty diff passthrough.", 7ULL, map.toText1( 7 ) );
+    }
+
     TEST_F( diff_match_patch_test, testDiffLevenshtein )
     {
         auto diffs = TDiffVector( { Diff( EOperation::eDELETE, "abc" ), Diff( EOperation::eINSERT, "1234" ), Diff( EOperation::eEQUAL, "xyz" ) } );
@@ -563,12 +665,12 @@ namespace NDiffMatchPatch
         // the insertion and deletion pairs are swapped.
         // If the order changes, tweak this test as required.
         auto diffs = TDiffVector( { Diff( EOperation::eDELETE, "c" ), Diff( EOperation::eINSERT, "m" ), Diff( EOperation::eEQUAL, "a" ), Diff( EOperation::eDELETE, "t" ), Diff( EOperation::eINSERT, "p" ) } );
-        auto results = dmp.diff_bisect( a, b, std::numeric_limits< clock_t >::max() );
+        auto results = dmp.diff_bisect( a, b, NDiffMatchPatch::SDeadline() );
         assertEquals( "diff_bisect: Normal.", diffs, results );
 
         // Timeout.
         diffs = { Diff( EOperation::eDELETE, "cat" ), Diff( EOperation::eINSERT, "map" ) };
-        results = dmp.diff_bisect( a, b, 0 );
+        results = dmp.diff_bisect( a, b, NDiffMatchPatch::SDeadline::expired() );
         assertEquals( "diff_bisect: Timeout.", diffs, results );
     }
 
@@ -638,17 +740,17 @@ namespace NDiffMatchPatch
             a = a + a;
             b = b + b;
         }
-        clock_t startTime = clock();
+        auto startTime = std::chrono::steady_clock::now();
         dmp.diff_main( a, b );
-        clock_t endTime = clock();
+        auto elapsed = std::chrono::duration< float >( std::chrono::steady_clock::now() - startTime ).count();
         // Test that we took at least the timeout period.
-        assertTrue( "diff_main: Timeout min.", ( dmp.Diff_Timeout * CLOCKS_PER_SEC ) <= ( endTime - startTime ) );
+        assertTrue( "diff_main: Timeout min.", dmp.Diff_Timeout <= elapsed );
         // Test that we didn't take forever (be forgiving).
         // Theoretically this test could fail very occasionally if the
         // OS task swaps or locks up for a second at the wrong moment.
         // Java seems to overrun by ~80% (compared with 10% for other languages).
         // Therefore use an upper limit of 0.5s instead of 0.2s.
-        assertTrue( "diff_main: Timeout max.", ( dmp.Diff_Timeout * CLOCKS_PER_SEC * 2 ) > ( endTime - startTime ) );
+        assertTrue( "diff_main: Timeout max.", ( dmp.Diff_Timeout * 2 ) > elapsed );
         dmp.Diff_Timeout = 0;
 
         // Test the linemode speedup.
@@ -678,6 +780,479 @@ namespace NDiffMatchPatch
         assertEquals( "diff_main: Overlap line-mode.", texts_textmode, texts_linemode );
     }
 
+    TEST_F( diff_match_patch_test, testDiffMainSpans )
+    {
+        std::wstring text1 = L"The quick brown fox jumped over the lazy dog.";
+        std::wstring text2 = L"That quick brown fox jumped over a lazy dog.";
+
+        auto diffs = dmp.diff_main( text1, text2, false );
+        auto spans = dmp.diff_main_spans( text1, text2, false );
+        assertEquals( "diff_main_spans: Hunk count.", diffs.size(), spans.size() );
+        for ( std::size_t ii = 0; ii < std::min( diffs.size(), spans.size() ); ++ii )
+        {
+            // materialize() round-trips each span back to an owning Diff.
+            assertEquals( "diff_main_spans: Hunk " + std::to_string( ii ) + " matches.", diffs[ ii ], spans[ ii ].materialize() );
+
+            // Each span must view into the caller-retained inputs, not a copy.
+            auto &&source = spans[ ii ].isInsert() ? text2 : text1;
+            bool viewsIntoInput = ( spans[ ii ].text().data() >= source.data() ) && ( ( spans[ ii ].text().data() + spans[ ii ].text().length() ) <= ( source.data() + source.length() ) );
+            assertTrue( "diff_main_spans: Hunk " + std::to_string( ii ) + " is zero-copy.", viewsIntoInput );
+        }
+
+        // Trivial cases.
+        assertTrue( "diff_main_spans: Equal inputs.", dmp.diff_main_spans( text1, text1 ).size() == 1 );
+        assertTrue( "diff_main_spans: Empty inputs.", dmp.diff_main_spans( std::wstring(), std::wstring() ).empty() );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffGranularity )
+    {
+        // A single-word change diffed at word granularity.
+        std::wstring text1 = L"the quick brown fox jumps over the lazy dog";
+        std::wstring text2 = L"the quick red fox jumps over the lazy dog";
+        auto diffs = dmp.diff_wordMode( text1, text2 );
+        TStringVector texts = diff_rebuildtexts( diffs );
+        assertEquals( "diff_wordMode: Rebuild text1.", text1, texts[ 0 ] );
+        assertEquals( "diff_wordMode: Rebuild text2.", text2, texts[ 1 ] );
+
+        // A single-sentence change diffed at sentence granularity.
+        text1 = L"First sentence. Second sentence! Third sentence?";
+        text2 = L"First sentence. Better sentence! Third sentence?";
+        diffs = dmp.diff_sentenceMode( text1, text2 );
+        texts = diff_rebuildtexts( diffs );
+        assertEquals( "diff_sentenceMode: Rebuild text1.", text1, texts[ 0 ] );
+        assertEquals( "diff_sentenceMode: Rebuild text2.", text2, texts[ 1 ] );
+
+        // The enum overload maps eCHARACTER/eLINE onto the checklines flag.
+        text1 = L"alpha\nbeta\ngamma\n";
+        text2 = L"alpha\ndelta\ngamma\n";
+        assertEquals( "diff_main granularity: eCHARACTER.", dmp.diff_main( text1, text2, false ), dmp.diff_main( text1, text2, EDiffGranularity::eCHARACTER ) );
+        assertEquals( "diff_main granularity: eLINE.", dmp.diff_main( text1, text2, true ), dmp.diff_main( text1, text2, EDiffGranularity::eLINE ) );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffLinesToTokens )
+    {
+        std::wstring text1 = L"alpha\nbeta\nalpha\n";
+        std::wstring text2 = L"beta\nalpha\nbeta\n";
+        auto tokens = dmp.diff_linesToTokens( text1, text2 );
+        assertEquals( "diff_linesToTokens: Shared lines intern once.", std::size_t( 3 ), tokens.fLines.size() );
+        assertTrue( "diff_linesToTokens: Encoded text1.", tokens.fTokens1 == std::u32string( { 1, 2, 1 } ) );
+        assertTrue( "diff_linesToTokens: Encoded text2.", tokens.fTokens2 == std::u32string( { 2, 1, 2 } ) );
+
+        // The interned lines must be views into the inputs, not copies.
+        for ( std::size_t ii = 1; ii < tokens.fLines.size(); ++ii )
+        {
+            auto &&line = tokens.fLines[ ii ];
+            bool viewsIntoInput = ( ( line.data() >= text1.data() ) && ( ( line.data() + line.length() ) <= ( text1.data() + text1.length() ) ) ) || ( ( line.data() >= text2.data() ) && ( ( line.data() + line.length() ) <= ( text2.data() + text2.length() ) ) );
+            assertTrue( "diff_linesToTokens: Line " + std::to_string( ii ) + " is zero-copy.", viewsIntoInput );
+        }
+
+        // More distinct lines than a 16-bit wchar_t could encode; line mode
+        // must still produce a valid diff.
+        text1.clear();
+        for ( int ii = 0; ii < 70000; ++ii )
+        {
+            text1 += L"line " + std::to_wstring( ii ) + L"\n";
+        }
+        text2 = text1;
+        text2.replace( text2.find( L"line 35017\n" ), 11, L"changed\n" );
+        TStringVector texts = diff_rebuildtexts( dmp.diff_main( text1, text2, true ) );
+        assertTrue( "diff_linesToTokens: Rebuild text1 past 65,535 lines.", texts[ 0 ] == text1 );
+        assertTrue( "diff_linesToTokens: Rebuild text2 past 65,535 lines.", texts[ 1 ] == text2 );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffThreads )
+    {
+        // Large inputs with scattered edits so diff_bisectSplit recurses on
+        // halves big enough to cross the parallel threshold.
+        std::wstring text1;
+        std::wstring text2;
+        for ( int ii = 0; ii < 4000; ++ii )
+        {
+            text1 += L"abcdefghijklmnopqrstuvwxyz0123456789 the quick brown fox\n";
+            text2 += ( ii % 17 == 0 ) ? L"abcdefghijklmnopqrstuvwxyz9876543210 the quick brown fox\n" : L"abcdefghijklmnopqrstuvwxyz0123456789 the quick brown fox\n";
+        }
+
+        // Disable the deadline so slow machines still diff both texts fully.
+        auto savedTimeout = dmp.Diff_Timeout;
+        dmp.Diff_Timeout = 0;
+        auto serial = dmp.diff_main( text1, text2, false );
+        dmp.Diff_Threads = 2;
+        auto parallel = dmp.diff_main( text1, text2, false );
+        dmp.Diff_Threads = 0;
+        dmp.Diff_Timeout = savedTimeout;
+        assertEquals( "diff_threads: Parallel result matches serial.", serial, parallel );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffCancel )
+    {
+        // Divergent middles so a full diff would produce many hunks.
+        std::wstring text1;
+        std::wstring text2;
+        for ( int ii = 0; ii < 500; ++ii )
+        {
+            text1 += L"shared prefix line " + std::to_wstring( ii ) + L" first variant\n";
+            text2 += L"shared prefix line " + std::to_wstring( ii ) + L" second variant\n";
+        }
+
+        // A pre-set cancellation flag makes the bisect bail out on its first
+        // poll, even with the timeout disabled, leaving the coarse
+        // delete+insert fallback around the common affixes.
+        std::atomic< bool > cancelled{ true };
+        auto savedTimeout = dmp.Diff_Timeout;
+        dmp.Diff_Timeout = 0;
+        dmp.Diff_Cancel = &cancelled;
+        auto diffs = dmp.diff_main( text1, text2, false );
+        dmp.Diff_Cancel = nullptr;
+        dmp.Diff_Timeout = savedTimeout;
+
+        assertTrue( "diff_cancel: Coarse fallback.", diffs.size() <= 4 );
+        std::wstring rebuilt1;
+        std::wstring rebuilt2;
+        for ( auto &&aDiff : diffs )
+        {
+            if ( !aDiff.isInsert() )
+                rebuilt1 += aDiff.text();
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        assertEquals( "diff_cancel: Rebuilds text1.", text1, rebuilt1 );
+        assertEquals( "diff_cancel: Rebuilds text2.", text2, rebuilt2 );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffBatch )
+    {
+        // A batch of varied pairs, including trivial cases.
+        diff_match_patch::TTextPairVector pairs;
+        pairs.emplace_back( L"", L"" );
+        pairs.emplace_back( L"same", L"same" );
+        pairs.emplace_back( L"The quick brown fox.", L"That quick red fox." );
+        for ( int ii = 0; ii < 40; ++ii )
+        {
+            auto num = std::to_wstring( ii );
+            pairs.emplace_back( L"line one " + num + L"\nline two\nline three " + num + L"\n", L"line 1 " + num + L"\nline two\nline third " + num + L"\n" );
+        }
+
+        // Serial and threaded batches both match per-pair diff_main.
+        auto serial = dmp.diff_batch( pairs, 0 );
+        auto threaded = dmp.diff_batch( pairs, 3 );
+        assertEquals( "diff_batch: Serial count.", pairs.size(), serial.size() );
+        assertEquals( "diff_batch: Threaded count.", pairs.size(), threaded.size() );
+        bool allMatch = true;
+        for ( std::size_t ii = 0; ii < pairs.size(); ++ii )
+        {
+            auto expected = dmp.diff_main( pairs[ ii ].first, pairs[ ii ].second );
+            allMatch = allMatch && equals( expected, serial[ ii ] ) && equals( expected, threaded[ ii ] );
+        }
+        assertTrue( "diff_batch: Results match diff_main.", allMatch );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffStats )
+    {
+        // Collection is off by default; a large-ish diff fills the counters
+        // in when it is on.
+        std::wstring text1;
+        std::wstring text2;
+        for ( int ii = 0; ii < 200; ++ii )
+        {
+            auto num = std::to_wstring( ii );
+            text1 += L"line " + num + L": the quick brown fox jumps over the lazy dog\n";
+            text2 += L"line " + num + ( ( ii % 7 == 0 ) ? L": the slow red fox strolls past the lazy dog\n" : L": the quick brown fox jumps over the lazy dog\n" );
+        }
+
+        dmp.Diff_CollectStats = true;
+        auto diffs = dmp.diff_main( text1, text2 );
+        dmp.Diff_CollectStats = false;
+        auto &&stats = dmp.diff_lastStats();
+        assertTrue( "diff_stats: Bisect ran.", stats.fBisectCalls > 0 );
+        assertTrue( "diff_stats: Iterations counted.", stats.fBisectIterations > 0 );
+        assertTrue( "diff_stats: Recursed.", stats.fMaxDepth > 0 );
+        assertTrue( "diff_stats: Line mode taken.", stats.fLineModeRuns > 0 );
+        assertTrue( "diff_stats: Half-match probed.", ( stats.fHalfMatchHits + stats.fHalfMatchMisses ) > 0 );
+        assertTrue( "diff_stats: Total timed.", stats.fTotalSeconds > 0 );
+        assertTrue( "diff_stats: No deadline abort.", stats.fDeadlineAborts == 0 );
+
+        // A cancelled diff shows up as a deadline abort instead of silence.
+        std::atomic< bool > cancelled{ true };
+        auto savedTimeout = dmp.Diff_Timeout;
+        dmp.Diff_Timeout = 0;
+        dmp.Diff_Cancel = &cancelled;
+        dmp.Diff_CollectStats = true;
+        diffs = dmp.diff_main( text1, text2, false );
+        dmp.Diff_CollectStats = false;
+        dmp.Diff_Cancel = nullptr;
+        dmp.Diff_Timeout = savedTimeout;
+        assertTrue( "diff_stats: Abort counted.", dmp.diff_lastStats().fDeadlineAborts > 0 );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffOptions )
+    {
+        // A shared (const) instance used only through the SOptions overloads.
+        const diff_match_patch shared;
+        diff_match_patch::SOptions options = shared.options();
+        assertTrue( "diff_options: Snapshot matches defaults.", ( options.fDiffTimeout == 1.0f ) && ( options.fMatchThreshold == 0.5f ) && ( options.fPatchMargin == 4 ) );
+
+        // Per-call diffs match the mutable entry point.
+        auto expected = dmp.diff_main( L"The quick brown fox.", L"That quick red fox." );
+        auto viaOptions = shared.diff_main( L"The quick brown fox.", L"That quick red fox.", options );
+        assertTrue( "diff_options: diff_main matches.", equals( expected, viaOptions ) );
+
+        // Per-call knobs take effect without touching the shared instance.
+        options.fMatchThreshold = 0.0f;
+        assertEquals( "diff_options: Strict match misses.", std::string::npos, shared.match_main( L"abcdefghijk", L"efxyz", 5, options ) );
+        options.fMatchThreshold = 0.7f;
+        assertEquals( "diff_options: Loose match hits.", 4ULL, shared.match_main( L"abcdefghijk", L"efxyz", 5, options ) );
+        assertTrue( "diff_options: Shared instance untouched.", shared.Match_Threshold == 0.5f );
+
+        // patch_apply through options round-trips.
+        auto patches = dmp.patch_make( L"The quick brown fox jumps over the lazy dog.", L"That quick red fox jumped over a lazy dog." );
+        auto results = shared.patch_apply( patches, L"The quick brown fox jumps over the lazy dog.", shared.options() );
+        assertEquals( "diff_options: patch_apply applies.", std::wstring( L"That quick red fox jumped over a lazy dog." ), results.first );
+
+        // Stats are delivered per call rather than through diff_lastStats().
+        diff_match_patch::SDiffStats stats;
+        options = shared.options();
+        options.fStats = &stats;
+        shared.diff_main( L"line one\nline two\nline three\n", L"line 1\nline two\nline third\n", options );
+        assertTrue( "diff_options: Stats collected per call.", stats.fBisectCalls > 0 );
+
+        // Many threads sharing one const instance, each with its own knobs.
+        std::vector< std::future< TDiffVector > > futures;
+        for ( int ii = 0; ii < 4; ++ii )
+        {
+            futures.push_back( std::async( std::launch::async,
+                                           [ &shared ]()
+                                           {
+                                               diff_match_patch::SOptions threadOptions;
+                                               return shared.diff_main( L"The quick brown fox.", L"That quick red fox.", threadOptions );
+                                           } ) );
+        }
+        bool allMatch = true;
+        for ( auto &&future : futures )
+            allMatch = allMatch && equals( expected, future.get() );
+        assertTrue( "diff_options: Concurrent calls match.", allMatch );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffMainAsync )
+    {
+        std::wstring text1;
+        std::wstring text2;
+        for ( int ii = 0; ii < 200; ++ii )
+        {
+            auto num = std::to_wstring( ii );
+            text1 += L"line " + num + L": the quick brown fox jumps over the lazy dog\n";
+            text2 += L"line " + num + ( ( ii % 7 == 0 ) ? L": the slow red fox strolls past the lazy dog\n" : L": the quick brown fox jumps over the lazy dog\n" );
+        }
+
+        // The async result matches the blocking call, and progress climbs
+        // monotonically to 1.0.
+        std::mutex mutex;
+        std::vector< float > reports;
+        auto future = dmp.diff_main_async( text1, text2,
+                                           [ & ]( float fraction )
+                                           {
+                                               std::lock_guard< std::mutex > lock( mutex );
+                                               reports.push_back( fraction );
+                                           } );
+        auto diffs = future.get();
+        auto expected = dmp.diff_main( text1, text2 );
+        assertTrue( "diff_main_async: Matches diff_main.", equals( expected, diffs ) );
+        assertTrue( "diff_main_async: Progress reported.", !reports.empty() );
+        bool monotone = true;
+        for ( std::size_t ii = 1; ii < reports.size(); ++ii )
+            monotone = monotone && ( reports[ ii - 1 ] <= reports[ ii ] ) && ( reports[ ii ] <= 1.0f );
+        assertTrue( "diff_main_async: Progress monotone.", monotone );
+        assertTrue( "diff_main_async: Finishes at 1.0.", reports.back() == 1.0f );
+
+        // Concurrent calls off one shared instance, no callback needed.
+        auto futureA = dmp.diff_main_async( text1, text2 );
+        auto futureB = dmp.diff_main_async( text2, text1 );
+        assertTrue( "diff_main_async: Concurrent A.", equals( expected, futureA.get() ) );
+        assertTrue( "diff_main_async: Concurrent B matches reverse.", equals( dmp.diff_main( text2, text1 ), futureB.get() ) );
+
+        // Cancellation flows through the per-call options.
+        std::atomic< bool > cancelled{ true };
+        diff_match_patch::SOptions options;
+        options.fDiffTimeout = 0;
+        options.fDiffCancel = &cancelled;
+        auto cancelledDiffs = dmp.diff_main_async( text1, text2, options ).get();
+        std::wstring rebuilt1;
+        std::wstring rebuilt2;
+        for ( auto &&aDiff : cancelledDiffs )
+        {
+            if ( !aDiff.isInsert() )
+                rebuilt1 += aDiff.text();
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        assertEquals( "diff_main_async: Cancelled still rebuilds text1.", text1, rebuilt1 );
+        assertEquals( "diff_main_async: Cancelled still rebuilds text2.", text2, rebuilt2 );
+    }
+
+    TEST_F( diff_match_patch_test, testIncrementalDiff )
+    {
+        // A sizeable document edited a little at a time.
+        std::wstring doc;
+        for ( int ii = 0; ii < 200; ++ii )
+        {
+            doc += L"paragraph " + std::to_wstring( ii ) + L": the quick brown fox jumps over the lazy dog.\n";
+        }
+
+        incremental_diff_session session( doc );
+        assertEquals( "incremental_diff: Retained text.", doc, session.text() );
+
+        // Each save is diffed against its predecessor.
+        auto previous = doc;
+        bool allRebuild = true;
+        std::vector< std::wstring > versions;
+        versions.push_back( doc.substr( 0, 5000 ) + L"inserted sentence. " + doc.substr( 5000 ) );
+        versions.push_back( versions.back().substr( 0, 20 ) + versions.back().substr( 60 ) );
+        versions.push_back( L"new leading line\n" + versions.back() );
+        versions.push_back( versions.back() + L"trailing line\n" );
+        for ( auto &&version : versions )
+        {
+            auto diffs = session.advance( version );
+            std::wstring rebuilt1;
+            std::wstring rebuilt2;
+            for ( auto &&aDiff : diffs )
+            {
+                if ( !aDiff.isInsert() )
+                    rebuilt1 += aDiff.text();
+                if ( !aDiff.isDelete() )
+                    rebuilt2 += aDiff.text();
+            }
+            allRebuild = allRebuild && ( rebuilt1 == previous ) && ( rebuilt2 == version );
+            previous = version;
+        }
+        assertTrue( "incremental_diff: Rebuilds every version.", allRebuild );
+        assertEquals( "incremental_diff: Tracks latest version.", versions.back(), session.text() );
+
+        // An identical save produces a single equality, like diff_main.
+        auto noop = session.advance( versions.back() );
+        assertTrue( "incremental_diff: No-op save.", ( noop.size() == 1 ) && noop[ 0 ].isEqual() );
+
+        // A simple edit matches a from-scratch diff_main.
+        session.reset( L"The quick brown fox." );
+        auto diffs = session.advance( L"The quick red fox." );
+        assertEquals( "incremental_diff: Matches diff_main.", dmp.diff_main( L"The quick brown fox.", L"The quick red fox." ), diffs );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffMainUtf8 )
+    {
+        diff_match_patch_utf8 dmp8;
+
+        // Trivial cases.
+        assertTrue( "diff_main_utf8: Empty case.", dmp8.diff_main( "", "" ).empty() );
+        auto diffs = dmp8.diff_main( "abc", "abc" );
+        assertTrue( "diff_main_utf8: Equality.", ( diffs.size() == 1 ) && diffs[ 0 ].isEqual() && ( diffs[ 0 ].text() == "abc" ) );
+
+        // Simple edits.
+        diffs = dmp8.diff_main( "abc", "ab123c" );
+        assertTrue( "diff_main_utf8: Simple insertion.", ( diffs.size() == 3 ) && diffs[ 1 ].isInsert() && ( diffs[ 1 ].text() == "123" ) );
+        diffs = dmp8.diff_main( "a123bc", "abc" );
+        assertTrue( "diff_main_utf8: Simple deletion.", ( diffs.size() == 3 ) && diffs[ 1 ].isDelete() && ( diffs[ 1 ].text() == "123" ) );
+
+        // The edited hunks must reassemble both inputs.
+        std::string text1 = "The quick brown fox jumped over the lazy dog.";
+        std::string text2 = "That quick brown fox jumped over a lazy dog.";
+        diffs = dmp8.diff_main( text1, text2 );
+        std::string rebuilt1, rebuilt2;
+        for ( auto &&aDiff : diffs )
+        {
+            if ( !aDiff.isInsert() )
+                rebuilt1 += aDiff.text();
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        assertEquals( "diff_main_utf8: Rebuild text1.", text1, rebuilt1 );
+        assertEquals( "diff_main_utf8: Rebuild text2.", text2, rebuilt2 );
+
+        // Multi-byte sequences: hunk boundaries must never split a code point.
+        // "héllo würld" vs "hèllo wörld" - the accented characters are two
+        // bytes each in UTF-8 and differ only in their continuation bytes.
+        text1 = "h\xC3\xA9llo w\xC3\xBCrld";
+        text2 = "h\xC3\xA8llo w\xC3\xB6rld";
+        diffs = dmp8.diff_main( text1, text2 );
+        rebuilt1.clear();
+        rebuilt2.clear();
+        for ( auto &&aDiff : diffs )
+        {
+            // A hunk may neither start with nor end inside a continuation byte.
+            bool startsMidSequence = !aDiff.text().empty() && ( ( static_cast< unsigned char >( aDiff.text().front() ) & 0xC0 ) == 0x80 );
+            assertFalse( "diff_main_utf8: Hunk starts on a code point.", startsMidSequence );
+            if ( !aDiff.isInsert() )
+                rebuilt1 += aDiff.text();
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        // Compare bytes directly; assertEquals on std::string would transcode
+        // through mbstowcs, which rejects these bytes in the "C" locale.
+        assertTrue( "diff_main_utf8: Rebuild multi-byte text1.", text1 == rebuilt1 );
+        assertTrue( "diff_main_utf8: Rebuild multi-byte text2.", text2 == rebuilt2 );
+
+        // Common prefix/suffix are backed off to code-point boundaries.
+        assertEquals( "diff_main_utf8: commonPrefix alignment.", 1, diff_match_patch_utf8::diff_commonPrefix( "a\xC3\xA9x", "a\xC3\xA8y" ) );
+        assertEquals( "diff_main_utf8: commonSuffix alignment.", 1, diff_match_patch_utf8::diff_commonSuffix( "x\xC3\xA9""a", "y\xC3\xA8""a" ) );
+
+        // "é" vs "©": the raw common suffix is a lone continuation byte
+        // under two different lead bytes, so it must shrink to nothing
+        // rather than swallow the unproven lead.
+        assertEquals( "diff_main_utf8: commonSuffix shrinks mid-sequence.", 0, diff_match_patch_utf8::diff_commonSuffix( "\xC3\xA9", "\xC2\xA9" ) );
+        diffs = dmp8.diff_main( "\xC3\xA9", "\xC2\xA9" );
+        rebuilt1.clear();
+        rebuilt2.clear();
+        for ( auto &&aDiff : diffs )
+        {
+            if ( !aDiff.isInsert() )
+                rebuilt1 += aDiff.text();
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        assertTrue( "diff_main_utf8: Rebuilds text1 with differing leads.", rebuilt1 == "\xC3\xA9" );
+        assertTrue( "diff_main_utf8: Rebuilds text2 with differing leads.", rebuilt2 == "\xC2\xA9" );
+    }
+
+    TEST_F( diff_match_patch_test, testDiffFiles )
+    {
+        diff_match_patch_utf8 dmp8;
+
+        // Write two versions of a document to disk and diff the files.
+        std::string text1;
+        std::string text2;
+        for ( int ii = 0; ii < 100; ++ii )
+        {
+            auto num = std::to_string( ii );
+            text1 += "line " + num + ": the quick brown fox\n";
+            text2 += "line " + num + ( ( ii == 40 ) ? ": the slow brown fox\n" : ": the quick brown fox\n" );
+        }
+        const std::string path1 = "testDiffFiles_1.txt";
+        const std::string path2 = "testDiffFiles_2.txt";
+        {
+            std::ofstream file1( path1, std::ios::binary );
+            file1 << text1;
+            std::ofstream file2( path2, std::ios::binary );
+            file2 << text2;
+        }
+
+        auto fromFiles = dmp8.diff_files( path1, path2 );
+        auto fromMemory = dmp8.diff_main( text1, text2 );
+        assertTrue( "diff_files: Matches in-memory diff.", equals( fromMemory, fromFiles ) );
+
+        // Hunk texts survive the unmap.
+        std::string rebuilt2;
+        for ( auto &&aDiff : fromFiles )
+        {
+            if ( !aDiff.isDelete() )
+                rebuilt2 += aDiff.text();
+        }
+        assertTrue( "diff_files: Rebuilds new file.", text2 == rebuilt2 );
+
+        // Missing inputs are an error.
+        assertThrow( "diff_files: Missing file throws.", dmp8.diff_files( path1, "testDiffFiles_missing.txt" ), std::wstring );
+
+        std::remove( path1.c_str() );
+        std::remove( path2.c_str() );
+    }
+
     //  MATCH TEST FUNCTIONS
 
     TEST_F( diff_match_patch_test, testMatchAlphabet )
@@ -742,6 +1317,85 @@ namespace NDiffMatchPatch
         assertEquals( "match_bitap: Distance test #3.", 0, dmp.match_bitap( "abcdefghijklmnopqrstuvwxyz", "abcdefg", 24 ) );
     }
 
+    TEST_F( diff_match_patch_test, testMatchBitapLong )
+    {
+        // Blocked bitap: patterns longer than the single-word engine's 32 bits.
+        dmp.Match_Distance = 1000;
+        dmp.Match_Threshold = 0.5f;
+        std::wstring text =
+            L"Measure twice and cut once, the old carpenter said, while the apprentice "
+            L"hurried through the workshop carrying planks of oak and cedar toward the "
+            L"half finished staircase; outside, rain gathered in the gutters and the "
+            L"smell of sawdust drifted over the quiet street where nobody was waiting.";
+
+        // One 64-bit word.
+        auto pattern = text.substr( 28, 50 );
+        assertEquals( "match_bitapLong: Exact match.", 28, dmp.match_bitap( text, pattern, 0 ) );
+        pattern[ 5 ] = L'X';
+        pattern[ 25 ] = L'Y';
+        assertEquals( "match_bitapLong: Fuzzy match.", 28, dmp.match_bitap( text, pattern, 0 ) );
+
+        // Three 64-bit words.
+        pattern = text.substr( 40, 150 );
+        assertEquals( "match_bitapLong: Multi-word exact.", 40, dmp.match_bitap( text, pattern, 20 ) );
+        pattern[ 10 ] = L'#';
+        pattern[ 80 ] = L'#';
+        pattern[ 140 ] = L'#';
+        assertEquals( "match_bitapLong: Multi-word fuzzy.", 40, dmp.match_bitap( text, pattern, 20 ) );
+        assertEquals( "match_bitapLong: No match.", -1, dmp.match_bitap( text, std::wstring( 100, L'@' ), 0 ) );
+
+        // Raising Match_MaxBits keeps whole hunks in one match pass and makes
+        // patch_splitMax a no-op.
+        dmp.Match_MaxBits = 512;
+        auto text2 = text;
+        text2.replace( 100, 8, L"sprinted" );
+        auto patches = dmp.patch_make( text, text2 );
+        dmp.patch_splitMax( patches );
+        assertEquals( "match_bitapLong: splitMax no-op below the raised limit.", dmp.patch_toText( dmp.patch_make( text, text2 ) ), dmp.patch_toText( patches ) );
+        auto results = dmp.patch_apply( patches, L"A new opening sentence. " + text );
+        assertEquals( "match_bitapLong: Patch apply with raised limit.", L"A new opening sentence. " + text2, results.first );
+        dmp.Match_MaxBits = 32;
+    }
+
+    TEST_F( diff_match_patch_test, testMatchPattern )
+    {
+        // A precompiled pattern searched against several candidate texts.
+        dmp.Match_Distance = 100;
+        dmp.Match_Threshold = 0.5f;
+        diff_match_patch::SMatchPattern pattern( L"fgh" );
+        assertEquals( "match_pattern: Exact match.", 5, dmp.match_main( L"abcdefghijk", pattern, 5 ) );
+        assertEquals( "match_pattern: Second text.", 2, dmp.match_main( L"xyfghij", pattern, 0 ) );
+        assertEquals( "match_pattern: No match.", -1, dmp.match_main( L"uvwxyz", pattern, 0 ) );
+
+        diff_match_patch::SMatchPattern fuzzy( L"efxhi" );
+        assertEquals( "match_pattern: Fuzzy match.", 4, dmp.match_main( L"abcdefghijk", fuzzy, 0 ) );
+
+        // The compiled alphabet must agree with the per-call one.
+        assertEquals( "match_pattern: Same result as match_bitap.", dmp.match_bitap( L"abcdefghijk", std::wstring( L"efxhi" ), 0 ), dmp.match_bitap( L"abcdefghijk", fuzzy, 0 ) );
+    }
+
+    TEST_F( diff_match_patch_test, testIndexedText )
+    {
+        std::wstring text = L"The quick brown fox jumps over the lazy dog. The quick onyx goblin jumps over the lazy dwarf.";
+        diff_match_patch::SIndexedText indexed( text );
+
+        // find/rfind must mirror std::wstring.
+        assertEquals( "indexed_text: find first.", text.find( L"jumps" ), indexed.find( L"jumps" ) );
+        assertEquals( "indexed_text: find from.", text.find( L"jumps", 30 ), indexed.find( L"jumps", 30 ) );
+        assertEquals( "indexed_text: find missing.", std::wstring::npos, indexed.find( L"zebra" ) );
+        assertEquals( "indexed_text: rfind.", text.rfind( L"jumps" ), indexed.rfind( L"jumps" ) );
+        assertEquals( "indexed_text: rfind from.", text.rfind( L"jumps", 30 ), indexed.rfind( L"jumps", 30 ) );
+        assertEquals( "indexed_text: Short pattern fallback.", text.find( L"ox" ), indexed.find( L"ox" ) );
+
+        // match_main against the index must agree with the plain scan.
+        dmp.Match_Distance = 1000;
+        dmp.Match_Threshold = 0.5f;
+        diff_match_patch::SMatchPattern pattern( L"quick onyx goblin" );
+        assertEquals( "indexed_text: match_main exact.", dmp.match_main( text, L"quick onyx goblin", 40 ), dmp.match_main( indexed, pattern, 40 ) );
+        diff_match_patch::SMatchPattern fuzzy( L"quick onyx hobgoblin" );
+        assertEquals( "indexed_text: match_main fuzzy.", dmp.match_main( text, L"quick onyx hobgoblin", 40 ), dmp.match_main( indexed, fuzzy, 40 ) );
+    }
+
     TEST_F( diff_match_patch_test, testMatchMain )
     {
         // Full match.
@@ -800,6 +1454,43 @@ namespace NDiffMatchPatch
                L"tes\n";
         patches = dmp.patch_fromText( strp );
         assertEquals( "patch_toText: Dua", strp, dmp.patch_toText( patches ) );
+
+        // The streaming sink produces the identical text.
+        std::wostringstream sink;
+        dmp.patch_toText( patches, sink );
+        assertEquals( "patch_toText: Stream sink.", strp, sink.str() );
+    }
+
+    TEST_F( diff_match_patch_test, testPatchBinary )
+    {
+        // Round trip through the binary format.
+        std::wstring text1 = L"The quick brown fox jumps over the lazy dog.";
+        std::wstring text2 = L"That quick brown fox jumped over a lazy dog.";
+        auto patches = dmp.patch_make( text1, text2 );
+        auto binary = dmp.patch_toBinary( patches );
+        auto decoded = dmp.patch_fromBinary( binary );
+        assertEquals( "patch_binary: Round trip.", dmp.patch_toText( patches ), dmp.patch_toText( decoded ) );
+
+        // Applying decoded patches gives the same result.
+        assertEquals( "patch_binary: Apply.", dmp.patch_apply( patches, text1 ).first, dmp.patch_apply( decoded, text1 ).first );
+
+        // Characters the text format must percent-encode pass through raw.
+        patches = dmp.patch_make( L"`1234567890-=[]\\;',./", L"~!@#$%^&*()_+{}|:\"<>?é" );
+        decoded = dmp.patch_fromBinary( dmp.patch_toBinary( patches ) );
+        assertEquals( "patch_binary: Special characters.", dmp.patch_toText( patches ), dmp.patch_toText( decoded ) );
+
+        // Empty list.
+        assertTrue( "patch_binary: Empty.", dmp.patch_fromBinary( dmp.patch_toBinary( TPatchVector() ) ).empty() );
+
+        // Generates error.
+        assertThrow( "patch_binary: Bad header.", dmp.patch_fromBinary( "Bad\nPatch\n" ), std::wstring );
+        binary = dmp.patch_toBinary( dmp.patch_make( text1, text2 ) );
+        assertThrow( "patch_binary: Truncated.", dmp.patch_fromBinary( std::string_view( binary ).substr( 0, binary.size() / 2 ) ), std::wstring );
+
+        // A tiny blob claiming 2^60 patches must be rejected before the
+        // count ever reaches a reserve call.
+        assertThrow( "patch_binary: Huge patch count.", dmp.patch_fromBinary( std::string( "DMP\x01" ) + "\x80\x80\x80\x80\x80\x80\x80\x80\x10" ), std::wstring );
+        assertThrow( "patch_binary: Huge diff count.", dmp.patch_fromBinary( std::string( "DMP\x01" ) + std::string( "\x01\x00\x01\x00\x01", 5 ) + "\x80\x80\x80\x80\x80\x80\x80\x80\x10" ), std::wstring );
     }
 
     TEST_F( diff_match_patch_test, testPatchAddContext )
@@ -820,6 +1511,19 @@ namespace NDiffMatchPatch
         p = dmp.patch_fromText( "@@ -3 +3,2 @@\n-e\n+at\n" )[ 0 ];
         dmp.patch_addContext( p, "The quick brown fox jumps.  The quick brown fox crashes." );
         assertEquals( "patch_addContext: Ambiguity.", L"@@ -1,27 +1,28 @@\n Th\n-e\n+at\n  quick brown fox jumps. \n", p.toString() );
+
+        // A large repetitive document forces the index-assisted probes; the
+        // resulting patches still round-trip through patch_apply.
+        std::wstring bigText1;
+        for ( int ii = 0; ii < 100; ++ii )
+        {
+            bigText1 += L"The quick brown fox jumps over the lazy dog.\n";
+        }
+        auto bigText2 = bigText1;
+        bigText2.replace( bigText2.find( L"jumps", 50 * 45 ), 5, L"leaps" );
+        auto patches = dmp.patch_make( bigText1, bigText2 );
+        auto results = dmp.patch_apply( patches, bigText1 );
+        assertEquals( "patch_addContext: Indexed round-trip.", bigText2, results.first );
     }
 
     TEST_F( diff_match_patch_test, testPatchMake )
@@ -1062,6 +1766,51 @@ namespace NDiffMatchPatch
         assertEquals( "patch_apply: Edge partial match.", L"x123\ttrue", resultStr );
     }
 
+    TEST_F( diff_match_patch_test, testPatchApplyBuffered )
+    {
+        dmp.Match_Distance = 1000;
+        dmp.Match_Threshold = 0.5f;
+        dmp.Patch_DeleteThreshold = 0.5f;
+
+        // The buffered mode must agree with patch_apply on ordinary patches.
+        std::wstring text1 = L"The quick brown fox jumps over the lazy dog.";
+        std::wstring text2 = L"That quick brown fox jumped over a lazy dog.";
+        auto patches = dmp.patch_make( text1, text2 );
+        auto classic = dmp.patch_apply( patches, text1 );
+        auto buffered = dmp.patch_applyBuffered( patches, text1 );
+        assertEquals( "patch_applyBuffered: Exact match text.", classic.first, buffered.first );
+
+        // A drifted target still matches.
+        std::wstring drifted = L"X marks the spot. " + text1;
+        classic = dmp.patch_apply( patches, drifted );
+        buffered = dmp.patch_applyBuffered( patches, drifted );
+        assertEquals( "patch_applyBuffered: Drifted text.", classic.first, buffered.first );
+        assertEquals( "patch_applyBuffered: Drifted flag.", NUtils::to_wstring( classic.second, false ), NUtils::to_wstring( buffered.second, false ) );
+
+        // Failed hunks are reported without disturbing the rest.
+        patches = dmp.patch_make( "abcdefghijklmnopqrstuvwxyz", "abcdefghijklmnopqrstuvwxyz123" );
+        buffered = dmp.patch_applyBuffered( patches, L"zyxwvutsrqponmlkjihgfedcba" );
+        assertEquals( "patch_applyBuffered: No match text.", L"zyxwvutsrqponmlkjihgfedcba", buffered.first );
+        assertEquals( "patch_applyBuffered: No match flag.", L"(false)", NUtils::to_wstring( buffered.second, false ) );
+
+        // Many hunks over a larger document, one materialization at the end.
+        std::wstring big1;
+        for ( int ii = 0; ii < 200; ++ii )
+        {
+            big1 += L"line " + std::to_wstring( ii ) + L" of the buffered apply corpus\n";
+        }
+        auto big2 = big1;
+        for ( int ii = 0; ii < 200; ii += 23 )
+        {
+            auto tag = L"line " + std::to_wstring( ii ) + L" of";
+            big2.replace( big2.find( tag ), tag.length(), L"line " + std::to_wstring( ii ) + L" at" );
+        }
+        patches = dmp.patch_make( big1, big2 );
+        classic = dmp.patch_apply( patches, big1 );
+        buffered = dmp.patch_applyBuffered( patches, big1 );
+        assertEquals( "patch_applyBuffered: Many hunks.", classic.first, buffered.first );
+    }
+
     TEST_F( diff_match_patch_test, fromGitHubExamples )
     {
         auto lhs = L"I am the very model of a modern Major-General, I've information "
@@ -57,6 +57,8 @@ namespace NDiffMatchPatch
         void testDiffCommonOverlap();
         void testDiffHalfmatch();
         void testDiffLinesToChars();
+        void testDiffLinesToTokens();
+        void testDiffGranularity();
         void testDiffCharsToLines();
         void testDiffCleanupMerge();
         void testDiffCleanupSemanticLossless();
@@ -70,9 +72,25 @@ namespace NDiffMatchPatch
         void testDiffLevenshtein();
         void testDiffBisect();
         void testDiffMain();
+        void testDiffMainSpans();
+        void testDiffThreads();
+        void testDiffCancel();
+        void testDiffBatch();
+        void testDiffStats();
+        void testDiffOptions();
+        void testDiffMainAsync();
+        void testDiffPositionMap();
+        void testIncrementalDiff();
+        void testDiffMainUtf8();
+        void testDiffFiles();
 
         //  MATCH TEST FUNCTIONS
         void testMatchAlphabet();
+        void testMatchBitapLong();
+        void testMatchPattern();
+        void testIndexedText();
+        void testPatchApplyBuffered();
+        void testPatchBinary();
         void testMatchBitap();
         void testMatchMain();
 
@@ -64,7 +64,7 @@ namespace NDiffMatchPatch
     {
         if ( d1 != d2 )
         {
-            reportFailure( strCase, d1.toString(), d2.toString() );
+            reportFailure( strCase, d1.toString( EStringType::eDefault ), d2.toString( EStringType::eDefault ) );
         }
         reportPassed( strCase );
     }
@@ -73,7 +73,7 @@ namespace NDiffMatchPatch
     {
         if ( var1 != var2 )
         {
-            reportFailure( strCase, NUtils::to_wstring( var1 ), NUtils::to_wstring( var2 ) );
+            reportFailure( strCase, NUtils::to_wstring( var1, false ), NUtils::to_wstring( var2, false ) );
         }
         reportPassed( strCase );
     }
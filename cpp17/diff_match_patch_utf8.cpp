@@ -0,0 +1,450 @@
+/*
+ * Diff Match and Patch
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "diff_match_patch_utf8.h"
+
+#include "diff_match_patch_core.h"
+#include "diff_match_patch_utils.h"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _WIN32
+    #include <fstream>
+    #include <sstream>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace NDiffMatchPatch
+{
+    namespace
+    {
+        // Read-only view of a whole file.  On POSIX the file is mmapped so
+        // the OS pages the bytes in on demand and nothing is copied into the
+        // process; elsewhere the contents are read into an owned buffer.
+        class SFileMapping
+        {
+        public:
+            explicit SFileMapping( const std::string &path )
+            {
+#ifdef _WIN32
+                std::ifstream file( path, std::ios::binary );
+                if ( !file )
+                {
+                    throw std::wstring( L"Unable to open file: " ) + NUtils::fromUtf8( path );
+                }
+                std::ostringstream buffer;
+                buffer << file.rdbuf();
+                fFallback = buffer.str();
+#else
+                auto fd = ::open( path.c_str(), O_RDONLY );
+                if ( fd < 0 )
+                {
+                    throw std::wstring( L"Unable to open file: " ) + NUtils::fromUtf8( path );
+                }
+                struct stat info
+                {
+                };
+                if ( ::fstat( fd, &info ) != 0 )
+                {
+                    ::close( fd );
+                    throw std::wstring( L"Unable to stat file: " ) + NUtils::fromUtf8( path );
+                }
+                fSize = static_cast< std::size_t >( info.st_size );
+                if ( fSize != 0 )
+                {
+                    auto mapped = ::mmap( nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+                    if ( mapped == MAP_FAILED )
+                    {
+                        ::close( fd );
+                        throw std::wstring( L"Unable to map file: " ) + NUtils::fromUtf8( path );
+                    }
+                    fData = static_cast< const char * >( mapped );
+                }
+                ::close( fd );
+#endif
+            }
+
+            ~SFileMapping()
+            {
+#ifndef _WIN32
+                if ( fData )
+                {
+                    ::munmap( const_cast< char * >( fData ), fSize );
+                }
+#endif
+            }
+
+            SFileMapping( const SFileMapping & ) = delete;
+            SFileMapping &operator=( const SFileMapping & ) = delete;
+
+            std::string_view view() const
+            {
+#ifdef _WIN32
+                return fFallback;
+#else
+                return std::string_view( fData, fSize );
+#endif
+            }
+
+        private:
+#ifdef _WIN32
+            std::string fFallback;
+#else
+            const char *fData{ nullptr };
+            std::size_t fSize{ 0 };
+#endif
+        };
+    }
+
+    // A UTF-8 continuation byte has the bit pattern 10xxxxxx.
+    static inline bool isContinuationByte( char ch )
+    {
+        return ( static_cast< unsigned char >( ch ) & 0xC0 ) == 0x80;
+    }
+
+    std::size_t diff_match_patch_utf8::alignToCodePoint( std::string_view text, std::size_t pos )
+    {
+        while ( ( pos > 0 ) && ( pos < text.length() ) && isContinuationByte( text[ pos ] ) )
+        {
+            pos--;
+        }
+        return pos;
+    }
+
+    std::size_t diff_match_patch_utf8::diff_commonPrefix( std::string_view text1, std::string_view text2 )
+    {
+        auto i = basic_diff_match_patch< char >::diff_commonPrefix( text1, text2 );
+        // Don't split a multi-byte sequence between the common and differing
+        // regions.
+        return alignToCodePoint( text1, i );
+    }
+
+    std::size_t diff_match_patch_utf8::diff_commonSuffix( std::string_view text1, std::string_view text2 )
+    {
+        auto i = basic_diff_match_patch< char >::diff_commonSuffix( text1, text2 );
+        // Shrink the suffix to a code-point boundary.  Moving the split
+        // left would claim lead bytes that were never proven common (the
+        // raw suffix may start mid-sequence under two different leads), so
+        // advance it forward past any continuation bytes instead.
+        auto pos = text1.length() - i;
+        while ( ( pos < text1.length() ) && isContinuationByte( text1[ pos ] ) )
+        {
+            pos++;
+        }
+        return text1.length() - pos;
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_main( std::string_view text1, std::string_view text2 )
+    {
+        // Set a deadline by which time the diff must be complete.
+        SDeadline deadline( Diff_Timeout, Diff_Cancel );
+        // One bisect workspace is shared by the whole recursion.
+        TBisectWorkspace workspace;
+        return diff_main( text1, text2, deadline, workspace );
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_files( const std::string &path1, const std::string &path2 )
+    {
+        SFileMapping file1( path1 );
+        SFileMapping file2( path2 );
+        // The engine works over the mappings directly; only the hunk texts
+        // of the result are copied out before the files are unmapped.
+        return diff_main( file1.view(), file2.view() );
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_main( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace )
+    {
+        // Check for equality (speedup).
+        TDiffBytesVector diffs;
+        if ( text1 == text2 )
+        {
+            if ( !text1.empty() )
+            {
+                diffs.emplace_back( EOperation::eEQUAL, text1 );
+            }
+            return diffs;
+        }
+
+        if ( !text1.empty() && text2.empty() )
+        {
+            diffs.emplace_back( EOperation::eDELETE, text1 );
+            return diffs;
+        }
+
+        if ( text1.empty() && !text2.empty() )
+        {
+            diffs.emplace_back( EOperation::eINSERT, text2 );
+            return diffs;
+        }
+
+        // Trim off common prefix (speedup).  Views avoid copying the chopped
+        // texts; diff_commonPrefix/Suffix keep the cuts on code-point
+        // boundaries.
+        auto commonlength = diff_commonPrefix( text1, text2 );
+        auto commonprefix = text1.substr( 0, commonlength );
+        auto textChopped1 = text1.substr( commonlength );
+        auto textChopped2 = text2.substr( commonlength );
+
+        // Trim off common suffix (speedup).
+        commonlength = diff_commonSuffix( textChopped1, textChopped2 );
+        auto commonsuffix = textChopped1.substr( textChopped1.length() - commonlength );
+        textChopped1 = textChopped1.substr( 0, textChopped1.length() - commonlength );
+        textChopped2 = textChopped2.substr( 0, textChopped2.length() - commonlength );
+
+        // Compute the diff on the middle block.
+        diffs = diff_compute( textChopped1, textChopped2, deadline, workspace );
+
+        // Restore the prefix and suffix.
+        if ( !commonprefix.empty() )
+        {
+            diffs.emplace( diffs.begin(), EOperation::eEQUAL, commonprefix );
+        }
+        if ( !commonsuffix.empty() )
+        {
+            diffs.emplace_back( EOperation::eEQUAL, commonsuffix );
+        }
+
+        diff_cleanupMerge( diffs );
+
+        return diffs;
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_compute( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace )
+    {
+        TDiffBytesVector diffs;
+
+        if ( text1.empty() )
+        {
+            // Just add some text (speedup).
+            diffs.emplace_back( EOperation::eINSERT, text2 );
+            return diffs;
+        }
+
+        if ( text2.empty() )
+        {
+            // Just delete some text (speedup).
+            diffs.emplace_back( EOperation::eDELETE, text1 );
+            return diffs;
+        }
+
+        {
+            auto [ longtext, shorttext ] = ( text1.length() > text2.length() ) ? std::make_pair( text1, text2 ) : std::make_pair( text2, text1 );
+            auto i = longtext.find( shorttext );
+            if ( i != std::string::npos )
+            {
+                // Shorter text is inside the longer text (speedup).  The find is
+                // byte-exact, so a match always starts and ends on code-point
+                // boundaries of the shorter text.
+                const auto op = ( text1.length() > text2.length() ) ? EOperation::eDELETE : EOperation::eINSERT;
+                diffs.emplace_back( op, longtext.substr( 0, i ) );
+                diffs.emplace_back( EOperation::eEQUAL, shorttext );
+                diffs.emplace_back( op, longtext.substr( i + shorttext.length() ) );
+                return diffs;
+            }
+
+            if ( shorttext.length() == 1 )
+            {
+                // Single character string.
+                // After the previous speedup, the character can't be an equality.
+                diffs.emplace_back( EOperation::eDELETE, text1 );
+                diffs.emplace_back( EOperation::eINSERT, text2 );
+                return diffs;
+            }
+        }
+
+        return diff_bisect( text1, text2, deadline, workspace );
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_bisect( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace )
+    {
+        std::size_t x = 0;
+        std::size_t y = 0;
+        if ( basic_diff_match_patch< char >::diff_bisect( text1, text2, deadline, x, y, workspace ) )
+        {
+            // Found a middle snake, split the problem in two and recurse.
+            return diff_bisectSplit( text1, text2, x, y, deadline, workspace );
+        }
+        // Diff took too long and hit the deadline or
+        // number of diffs equals number of characters, no commonality at all.
+        auto diffs = TDiffBytesVector( { DiffBytes( EOperation::eDELETE, text1 ), DiffBytes( EOperation::eINSERT, text2 ) } );
+        return diffs;
+    }
+
+    TDiffBytesVector diff_match_patch_utf8::diff_bisectSplit( std::string_view text1, std::string_view text2, std::size_t x, std::size_t y, const SDeadline &deadline, TBisectWorkspace &workspace )
+    {
+        // The middle snake is found on byte coordinates; pull each side of the
+        // split back to a code-point boundary so neither half starts or ends
+        // mid-sequence.  The bytes given back become part of the differing
+        // region, which is always safe, just potentially non-minimal.
+        x = alignToCodePoint( text1, x );
+        y = alignToCodePoint( text2, y );
+        if ( ( ( x == 0 ) && ( y == 0 ) ) || ( ( x == text1.length() ) && ( y == text2.length() ) ) )
+        {
+            // Alignment collapsed the split onto an end of the problem, so
+            // recursing would not shrink it.  Emit the coarse hunks instead.
+            return TDiffBytesVector( { DiffBytes( EOperation::eDELETE, text1 ), DiffBytes( EOperation::eINSERT, text2 ) } );
+        }
+
+        auto text1a = text1.substr( 0, x );
+        auto text2a = text2.substr( 0, y );
+        auto text1b = text1.substr( x );
+        auto text2b = text2.substr( y );
+
+        // Compute both diffs serially.
+        TDiffBytesVector diffs = diff_main( text1a, text2a, deadline, workspace );
+        TDiffBytesVector diffsb = diff_main( text1b, text2b, deadline, workspace );
+
+        diffs.insert( diffs.end(), diffsb.begin(), diffsb.end() );
+        return diffs;
+    }
+
+    void diff_match_patch_utf8::diff_cleanupMerge( TDiffBytesVector &diffs )
+    {
+        diffs.emplace_back( EOperation::eEQUAL, std::string_view() );
+        std::size_t pointer = 0;
+        int count_delete = 0;
+        int count_insert = 0;
+        std::string text_delete;
+        std::string text_insert;
+
+        while ( pointer < diffs.size() )
+        {
+            if ( diffs[ pointer ].isInsert() )
+            {
+                count_insert++;
+                text_insert += diffs[ pointer ].text();
+                pointer++;
+            }
+            else if ( diffs[ pointer ].isDelete() )
+            {
+                count_delete++;
+                text_delete += diffs[ pointer ].text();
+                pointer++;
+            }
+            else if ( diffs[ pointer ].isEqual() )
+            {
+                // Upon reaching an equality, check for prior redundancies.
+                if ( count_delete + count_insert > 1 )
+                {
+                    if ( count_delete != 0 && count_insert != 0 )
+                    {
+                        // Factor out any common prefixies.
+                        auto commonlength = diff_commonPrefix( text_insert, text_delete );
+                        if ( commonlength != 0 )
+                        {
+                            if ( ( pointer > std::size_t( count_delete + count_insert ) ) && diffs[ pointer - ( count_delete + count_insert ) - 1 ].isEqual() )
+                            {
+                                diffs[ pointer - count_delete - count_insert - 1 ].fText += text_insert.substr( 0, commonlength );
+                            }
+                            else
+                            {
+                                diffs.emplace( diffs.begin(), EOperation::eEQUAL, text_insert.substr( 0, commonlength ) );
+                                pointer++;
+                            }
+                            text_insert = text_insert.substr( commonlength );
+                            text_delete = text_delete.substr( commonlength );
+                        }
+                        // Factor out any common suffixies.
+                        commonlength = diff_commonSuffix( text_insert, text_delete );
+                        if ( commonlength != 0 )
+                        {
+                            diffs[ pointer ].fText = text_insert.substr( text_insert.length() - commonlength ) + diffs[ pointer ].text();
+                            text_insert = text_insert.substr( 0, text_insert.length() - commonlength );
+                            text_delete = text_delete.substr( 0, text_delete.length() - commonlength );
+                        }
+                    }
+                    // Delete the offending records and add the merged ones.
+                    pointer -= count_delete + count_insert;
+                    diffs.erase( diffs.begin() + pointer, diffs.begin() + pointer + count_delete + count_insert );
+                    if ( !text_delete.empty() )
+                    {
+                        diffs.emplace( diffs.begin() + pointer, EOperation::eDELETE, text_delete );
+                        pointer++;
+                    }
+                    if ( !text_insert.empty() )
+                    {
+                        diffs.emplace( diffs.begin() + pointer, EOperation::eINSERT, text_insert );
+                        pointer++;
+                    }
+                    pointer++;
+                }
+                else if ( pointer != 0 && diffs[ pointer - 1 ].isEqual() )
+                {
+                    // Merge this equality with the previous one.
+                    diffs[ pointer - 1 ].fText += diffs[ pointer ].text();
+                    diffs.erase( diffs.begin() + pointer );
+                }
+                else
+                {
+                    pointer++;
+                }
+                count_insert = 0;
+                count_delete = 0;
+                text_delete.clear();
+                text_insert.clear();
+            }
+        }
+        if ( diffs.back().text().empty() )
+        {
+            diffs.pop_back();   // Remove the dummy entry at the end.
+        }
+
+        // Second pass: look for single edits surrounded on both sides by
+        // equalities which can be shifted sideways to eliminate an equality.
+        // e.g: A<ins>BA</ins>C -> <ins>AB</ins>AC
+        bool changes = false;
+        pointer = 1;
+        // Intentionally ignore the first and last element (don't need checking).
+        while ( !diffs.empty() && pointer < ( diffs.size() - 1 ) )
+        {
+            if ( diffs[ pointer - 1 ].isEqual() && diffs[ pointer + 1 ].isEqual() )
+            {
+                // This is a single edit surrounded by equalities.
+                auto &&prevText = diffs[ pointer - 1 ].text();
+                auto &&nextText = diffs[ pointer + 1 ].text();
+                if ( ( diffs[ pointer ].text().length() >= prevText.length() ) && ( diffs[ pointer ].text().compare( diffs[ pointer ].text().length() - prevText.length(), prevText.length(), prevText ) == 0 ) )
+                {
+                    // Shift the edit over the previous equality.
+                    diffs[ pointer ].fText = prevText + diffs[ pointer ].text().substr( 0, diffs[ pointer ].text().length() - prevText.length() );
+                    diffs[ pointer + 1 ].fText = prevText + diffs[ pointer + 1 ].text();
+                    diffs.erase( diffs.begin() + pointer - 1 );
+                    changes = true;
+                }
+                else if ( diffs[ pointer ].text().find( nextText ) == 0 )
+                {
+                    // Shift the edit over the next equality.
+                    diffs[ pointer - 1 ].fText += nextText;
+                    diffs[ pointer ].fText = diffs[ pointer ].text().substr( nextText.length() ) + nextText;
+                    diffs.erase( diffs.begin() + pointer + 1 );
+                    changes = true;
+                }
+            }
+            pointer++;
+        }
+        // If shifts were made, the diff needs reordering and another shift sweep.
+        if ( changes )
+        {
+            diff_cleanupMerge( diffs );
+        }
+    }
+}
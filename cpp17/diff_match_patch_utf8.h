@@ -0,0 +1,148 @@
+/*
+ * Diff Match and Patch
+ * Copyright 2018 The diff-match-patch Authors.
+ * https://github.com/google/diff-match-patch
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DIFF_MATCH_PATCH_UTF8_H
+#define DIFF_MATCH_PATCH_UTF8_H
+
+#include "diff_match_patch.h"
+#include "diff_match_patch_core.h"
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Byte-oriented diff engine for UTF-8 text.
+ *
+ * The std::string overloads on diff_match_patch first widen the whole input
+ * via NUtils::to_wstring (std::mbstowcs), which quadruples the working-set
+ * size on platforms with a 32-bit wchar_t before any diffing starts.  This
+ * engine runs the Myers bisect directly over the UTF-8 bytes and only takes
+ * care that hunk boundaries never land inside a multi-byte sequence, so a
+ * UTF-8 document is diffed with no transcode and no width expansion.
+ */
+
+namespace NDiffMatchPatch
+{
+    /**
+ * Class representing one byte-oriented diff operation.  The text is UTF-8.
+ */
+    class DiffBytes
+    {
+    public:
+        DiffBytes() = default;
+        DiffBytes( EOperation _operation, std::string_view _text ) :
+            fOperation( _operation ),
+            fText( _text )
+        {
+        }
+
+        bool isDelete() const { return fOperation == EOperation::eDELETE; }
+        bool isInsert() const { return fOperation == EOperation::eINSERT; }
+        bool isEqual() const { return fOperation == EOperation::eEQUAL; }
+
+        const std::string &text() const { return fText; }
+
+        bool operator==( const DiffBytes &d ) const { return ( d.fOperation == fOperation ) && ( d.fText == fText ); }
+        bool operator!=( const DiffBytes &d ) const { return !( operator==( d ) ); }
+
+        EOperation fOperation{ EOperation::eDELETE };
+        std::string fText;
+    };
+    using TDiffBytesVector = std::vector< DiffBytes >;
+
+    /**
+ * Byte-oriented diff engine.  Behaviour settings mirror diff_match_patch.
+ */
+    class diff_match_patch_utf8
+    {
+    public:
+        // Number of seconds to map a diff before giving up (0 for infinity).
+        float Diff_Timeout{ 1.0f };
+        // Optional cancellation token checked alongside the deadline; set the
+        // flag to make diff_main bail out early with a best-effort result.
+        const std::atomic< bool > *Diff_Cancel{ nullptr };
+
+        using TBisectWorkspace = basic_diff_match_patch< char >::SBisectWorkspace;
+
+        diff_match_patch_utf8() = default;
+
+        /**
+   * Find the differences between two UTF-8 texts without transcoding.
+   * Hunk boundaries are guaranteed to fall on code-point boundaries.
+   * @param text1 Old string to be diffed.
+   * @param text2 New string to be diffed.
+   * @return Vector of DiffBytes objects.
+   */
+        TDiffBytesVector diff_main( std::string_view text1, std::string_view text2 );
+
+        /**
+   * Find the differences between two files straight from disk.  Both files
+   * are memory-mapped read-only and the byte engine runs over the
+   * mappings, so neither input is ever loaded into an owned buffer or
+   * widened; the OS pages the bytes in on demand.  Only the hunk texts in
+   * the result are copied out of the mappings.
+   * @param path1 Path of the old file.
+   * @param path2 Path of the new file.
+   * @return Vector of DiffBytes objects.
+   * @throws std::wstring If either file cannot be opened or mapped.
+   */
+        TDiffBytesVector diff_files( const std::string &path1, const std::string &path2 );
+
+        /**
+   * Determine the common prefix of two strings, backed off to a UTF-8
+   * code-point boundary.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The number of bytes common to the start of each string.
+   */
+        static std::size_t diff_commonPrefix( std::string_view text1, std::string_view text2 );
+
+        /**
+   * Determine the common suffix of two strings, backed off to a UTF-8
+   * code-point boundary.
+   * @param text1 First string.
+   * @param text2 Second string.
+   * @return The number of bytes common to the end of each string.
+   */
+        static std::size_t diff_commonSuffix( std::string_view text1, std::string_view text2 );
+
+        /**
+   * Move a split position left until it no longer lands inside a multi-byte
+   * UTF-8 sequence.
+   * @param text The text being split.
+   * @param pos Candidate split position (in bytes).
+   * @return The nearest code-point boundary at or before pos.
+   */
+        static std::size_t alignToCodePoint( std::string_view text, std::size_t pos );
+
+        /**
+   * Reorder and merge like edit sections.  Merge equalities.
+   * @param diffs Vector of DiffBytes objects.
+   */
+        void diff_cleanupMerge( TDiffBytesVector &diffs );
+
+    private:
+        TDiffBytesVector diff_main( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace );
+        TDiffBytesVector diff_compute( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace );
+        TDiffBytesVector diff_bisect( std::string_view text1, std::string_view text2, const SDeadline &deadline, TBisectWorkspace &workspace );
+        TDiffBytesVector diff_bisectSplit( std::string_view text1, std::string_view text2, std::size_t x, std::size_t y, const SDeadline &deadline, TBisectWorkspace &workspace );
+    };
+}
+#endif   // DIFF_MATCH_PATCH_UTF8_H
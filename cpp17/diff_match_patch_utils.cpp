@@ -19,6 +19,7 @@
 #include "diff_match_patch_utils.h"
 
 #include <codecvt>
+#include <limits>
 #include <locale>
 
 namespace NDiffMatchPatch
@@ -84,20 +85,31 @@ namespace NDiffMatchPatch
 
             static_assert( sizeof( wchar_t ) <= 4, "wchar_t is greater that 32 bit" );
 
+            // One conversion for the whole input rather than one per
+            // character; the per-byte encoding then appends into the single
+            // reserved buffer.
             std::wstring_convert< std::codecvt_utf8< wchar_t > > utf8_conv;
-            for ( auto &&c : input )
+            auto asBytes = utf8_conv.to_bytes( input );
+            for ( auto &&ii : asBytes )
             {
-                auto currStr = std::wstring( 1, c );
-                auto asBytes = utf8_conv.to_bytes( currStr );
-                for ( auto &&ii : asBytes )
-                {
-                    if ( ii )
-                        retVal += toPercentEncoding( ii, exclude, include );
-                }
+                if ( ii )
+                    retVal += toPercentEncoding( ii, exclude, include );
             }
             return retVal;
         }
 
+        std::string toUtf8( const std::wstring &input )
+        {
+            std::wstring_convert< std::codecvt_utf8< wchar_t > > utf8_conv;
+            return utf8_conv.to_bytes( input );
+        }
+
+        std::wstring fromUtf8( std::string_view bytes )
+        {
+            std::wstring_convert< std::codecvt_utf8< wchar_t > > utf8_conv;
+            return utf8_conv.from_bytes( bytes.data(), bytes.data() + bytes.size() );
+        }
+
         wchar_t getValue( wchar_t ch )
         {
             if ( ch >= '0' && ch <= '9' )
@@ -144,6 +156,38 @@ namespace NDiffMatchPatch
             return asBytes;
         }
 
+        std::wstring fromPercentEncoding( std::wstring_view input, bool plusIsLiteral )
+        {
+            if ( input.empty() )
+                return {};
+            std::string retVal;
+            retVal.reserve( input.length() );
+            for ( auto ii = 0ULL; ii < input.length(); ++ii )
+            {
+                auto c = input[ ii ];
+                if ( c == L'%' && ( ii + 2 ) < input.length() )
+                {
+                    auto a = input[ ++ii ];
+                    auto b = input[ ++ii ];
+                    a = getValue( a );
+                    b = getValue( b );
+                    a = a << 4;
+                    auto value = a | b;
+                    retVal += std::string( 1, value );
+                }
+                else if ( ( c == '+' ) && !plusIsLiteral )
+                    retVal += ' ';
+                else
+                {
+                    retVal += c;
+                }
+            }
+            std::wstring_convert< std::codecvt_utf8< wchar_t > > utf8_conv;
+            auto asBytes = utf8_conv.from_bytes( retVal );
+
+            return asBytes;
+        }
+
         bool endsWith( const std::wstring &string, const std::wstring &suffix )
         {
             if ( suffix.length() > string.length() )
@@ -197,5 +241,35 @@ namespace NDiffMatchPatch
             return retVal;
         }
 
+        int64_t toInt( std::wstring_view string )
+        {
+            // Allocation-free counterpart of the std::wstring overload with
+            // the same contract: 0 on any invalid input, and negative inputs
+            // are returned negative so callers can reject them.
+            if ( string.empty() )
+                return 0;
+            bool negative = false;
+            std::size_t ii = 0;
+            if ( ( string[ 0 ] == L'-' ) || ( string[ 0 ] == L'+' ) )
+            {
+                negative = ( string[ 0 ] == L'-' );
+                ii = 1;
+            }
+            if ( ii == string.length() )
+                return 0;
+            int64_t retVal = 0;
+            for ( ; ii < string.length(); ++ii )
+            {
+                auto ch = string[ ii ];
+                if ( ( ch < L'0' ) || ( ch > L'9' ) )
+                    return 0;
+                auto digit = static_cast< int64_t >( ch - L'0' );
+                if ( retVal > ( std::numeric_limits< int64_t >::max() - digit ) / 10 )
+                    return 0;
+                retVal = retVal * 10 + digit;
+            }
+            return negative ? -retVal : retVal;
+        }
+
     }   // namespace NUtils
 }
@@ -22,6 +22,7 @@
 //
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <vector>
 namespace NDiffMatchPatch
 {
@@ -88,6 +89,29 @@ namespace NDiffMatchPatch
  */
         std::wstring fromPercentEncoding( const std::wstring &input );
 
+        /**
+ * single-pass variant of fromPercentEncoding over a view; when
+ * plusIsLiteral is set a '+' decodes to itself instead of a space
+ * @param input the input view to decode
+ * @param plusIsLiteral whether '+' is kept literal
+ * @return the decoded string
+ */
+        std::wstring fromPercentEncoding( std::wstring_view input, bool plusIsLiteral );
+
+        /**
+ * returns the UTF-8 encoded bytes of the string
+ * @param input the input String to encode
+ * @return the encoded bytes
+ */
+        std::string toUtf8( const std::wstring &input );
+
+        /**
+ * decodes UTF-8 bytes back into a wide string
+ * @param bytes the UTF-8 bytes to decode
+ * @return the decoded string
+ */
+        std::wstring fromUtf8( std::string_view bytes );
+
         /**
  * replaces returns integer value of the character, '0'-'9' = 0-9, 'A'-'F' =
  * 10-15, 'a'-'f' = 10-15
@@ -102,6 +126,7 @@ namespace NDiffMatchPatch
  * @return the integer version, on an invalid input returns 0
  */
         int64_t toInt( const std::wstring &string );
+        int64_t toInt( std::wstring_view string );
 
         /**
  * return true if the string has the suffix
@@ -157,6 +182,9 @@ namespace NDiffMatchPatch
         template< typename STRING_TYPE >
         using is_wstring = typename std::is_same< std::wstring, base_type_t< STRING_TYPE > >;
 
+        template< typename STRING_TYPE >
+        using is_wstring_view = typename std::is_same< std::wstring_view, base_type_t< STRING_TYPE > >;
+
         template< typename STRING_TYPE >
         using is_wcharstar = typename std::is_same< wchar_t *, base_type_t< STRING_TYPE > >;
 
@@ -323,6 +351,7 @@ namespace NDiffMatchPatch
         {
             static_assert(
                 is_wstring< STRING_TYPE >::value   //
+                || is_wstring_view< STRING_TYPE >::value   //
                 || is_wcharstar< STRING_TYPE >::value   //
                 || is_string< STRING_TYPE >::value   //
                 || is_charstar< STRING_TYPE >::value   //
@@ -332,6 +361,8 @@ namespace NDiffMatchPatch
 
             if constexpr ( is_wstring< STRING_TYPE >::value )
                 return string;
+            else if constexpr ( is_wstring_view< STRING_TYPE >::value )
+                return std::wstring( string );
             else if constexpr ( is_wcharstar< STRING_TYPE >::value )
                 return std::wstring( string ? string : L"" );
             else if constexpr ( is_string< STRING_TYPE >::value )